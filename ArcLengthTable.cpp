@@ -0,0 +1,132 @@
+/************************************************************************
+     File:        ArcLengthTable.cpp
+
+     Comment:     Cached arc length parameterization of the track.
+						See ArcLengthTable.H
+
+*************************************************************************/
+
+#include <math.h>
+#include <algorithm>
+
+#include "ArcLengthTable.H"
+#include "Track.H"
+#include "Spline.H"
+
+//****************************************************************************
+//
+// * Constructor
+//============================================================================
+ArcLengthTable::
+ArcLengthTable()
+	: valid(false), builtVersion(0), builtSplineType(-1), builtSamples(0)
+//============================================================================
+{
+}
+
+//****************************************************************************
+//
+// * Sample the curve and accumulate the chord lengths
+//============================================================================
+bool ArcLengthTable::
+update(const CTrack& track, int splineType, unsigned int samplesPerSegment)
+//============================================================================
+{
+	if (valid &&
+		builtVersion == track.pointsVersion &&
+		builtSplineType == splineType &&
+		builtSamples == samplesPerSegment)
+		return false;
+
+	size_t spans = track.points.size() * samplesPerSegment;
+
+	lengths.resize(spans + 1);
+	lengths[0] = 0;
+
+	Pnt3f prev = evalSplinePoint(track.points, splineType, 0.0f);
+	for (size_t i = 1; i <= spans; ++i) {
+		// the last sample is the start of the track again
+		Pnt3f cur = evalSplinePoint(track.points, splineType, (float)(i % spans) / spans);
+		Pnt3f d = cur - prev;
+		lengths[i] = lengths[i - 1] + sqrtf(d.x * d.x + d.y * d.y + d.z * d.z);
+		prev = cur;
+	}
+
+	valid = true;
+	builtVersion = track.pointsVersion;
+	builtSplineType = splineType;
+	builtSamples = samplesPerSegment;
+	return true;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void ArcLengthTable::
+invalidate()
+//============================================================================
+{
+	valid = false;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+float ArcLengthTable::
+length() const
+//============================================================================
+{
+	return lengths.empty() ? 0.0f : lengths.back();
+}
+
+//****************************************************************************
+//
+// * interpolate between the two samples around u
+//============================================================================
+float ArcLengthTable::
+lengthAt(float u) const
+//============================================================================
+{
+	if (lengths.size() < 2)
+		return 0.0f;
+
+	u -= floorf(u);
+	size_t spans = lengths.size() - 1;
+	float f = u * spans;
+	size_t i = std::min((size_t)f, spans - 1);
+	float a = f - i;
+
+	return lengths[i] + a * (lengths[i + 1] - lengths[i]);
+}
+
+//****************************************************************************
+//
+// * binary search for the span holding s, then interpolate inside it
+//============================================================================
+float ArcLengthTable::
+paramAt(float s) const
+//============================================================================
+{
+	float total = length();
+	if (total <= 0.0f)
+		return 0.0f;
+
+	s = fmodf(s, total);
+	if (s < 0)
+		s += total;
+
+	size_t spans = lengths.size() - 1;
+
+	// first sample strictly past s - the span we want ends there
+	size_t hi = std::upper_bound(lengths.begin(), lengths.end(), s) - lengths.begin();
+	hi = std::min(std::max(hi, (size_t)1), spans);
+	size_t lo = hi - 1;
+
+	float span = lengths[hi] - lengths[lo];
+	float a = (span > 0.0f) ? (s - lengths[lo]) / span : 0.0f;
+
+	float u = (lo + a) / spans;
+	return (u >= 1.0f) ? u - 1.0f : u;
+}
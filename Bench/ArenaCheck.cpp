@@ -0,0 +1,141 @@
+/************************************************************************
+     File:        ArenaCheck.cpp
+
+     Comment:     Draws the Gundam parts through ModelArena on a headless
+						context and checks where they land.
+
+						Every part of two characters gets a cell of its
+						own on a 7 x 7 grid (the first character on the
+						top half), so the one glMultiDrawElementsIndirect
+						only fills every cell if each command found its
+						own transform: the base instance, the per draw
+						record it picks and the storage buffer it indexes
+						all have to agree. Then the material colors that
+						come out are counted, and GL errors looked for.
+						Prints one JSON object; exits 1 on a failure.
+
+						Usage: arena_check [source directory]
+						(the one with Obj/ and shaders/, .. by default)
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "HeadlessGL.H"
+#include "../ModelArena.H"
+#include "../ShadowMap.H"
+#include "../RenderUtilities/Shader.h"
+
+#define PARTS		18
+#define CHARACTERS	2
+#define GRID		7		// cells a side
+#define CELL		40		// pixels a side
+#define SIZE		(GRID * CELL)
+
+int main(int argc, char** argv)
+{
+	const std::string source = argc > 1 ? argv[1] : "..";
+
+	if (!makeHeadlessContext())
+		return 1;
+	HeadlessTarget target(SIZE, SIZE);
+
+	static const char* parts[PARTS] = {
+		"body", "ulefthand", "dlefthand", "lefthand", "lshouder", "head",
+		"urighthand", "drighthand", "righthand", "rshouder", "back2", "dbody",
+		"uleftleg", "dleftleg", "leftfoot", "urightleg", "drightleg", "rightfoot",
+	};
+	ModelArena arena;
+	if (!arena.loadMaterials((source + "/Obj/gundam.mtl").c_str()))
+		return 1;
+	for (int p = 0; p < PARTS; ++p)
+		if (arena.addPart((source + "/Obj/" + parts[p] + ".obj").c_str()) != p)
+			return 1;
+	arena.setCapacity(CHARACTERS);
+
+	Shader shader((source + "/shaders/model.vert").c_str(), nullptr, nullptr, nullptr,
+		(source + "/shaders/model.frag").c_str(), (source + "/shaders/shadow.frag").c_str());
+
+	// the parts reach about 6.5 from their middle: 3 pixels a unit keeps
+	// each inside its cell
+	for (int c = 0; c < CHARACTERS; ++c)
+		for (int p = 0; p < PARTS; ++p) {
+			int cell = c * PARTS + p;
+			float x = (cell % GRID + 0.5f) * CELL, y = SIZE - (cell / GRID + 0.5f) * CELL;
+			const float m[16] = {
+				3.0f, 0.0f, 0.0f, 0.0f,
+				0.0f, 3.0f, 0.0f, 0.0f,
+				0.0f, 0.0f, 3.0f, 0.0f,
+				x,    y,    0.0f, 1.0f };
+			arena.setTransform(c, p, m);
+		}
+
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glOrtho(0, SIZE, 0, SIZE, -100, 100);
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+
+	// the shader links shaders/shadow.frag: give it a map that is off.
+	// Making the map leaves the default framebuffer bound
+	ShadowMap shadows;
+	shadows.resolution = 16;
+	shadows.disable();
+	target.bind();
+
+	glEnable(GL_DEPTH_TEST);
+	glClearColor(1.0f, 0.0f, 1.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	arena.draw(CHARACTERS, &shader, false);
+	GLenum error = glGetError();
+
+	std::vector<unsigned char> pixels((size_t)SIZE * SIZE * 4);
+	glReadPixels(0, 0, SIZE, SIZE, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+	// the cells something was drawn in, and the colors it came in
+	int filled = 0;
+	std::set<unsigned int> colors;
+	for (int cell = 0; cell < CHARACTERS * PARTS; ++cell) {
+		int x0 = (cell % GRID) * CELL, y0 = SIZE - (cell / GRID + 1) * CELL;
+		int covered = 0;
+		for (int y = y0; y < y0 + CELL; ++y)
+			for (int x = x0; x < x0 + CELL; ++x) {
+				const unsigned char* px = &pixels[((size_t)y * SIZE + x) * 4];
+				if (px[0] == 255 && px[1] == 0 && px[2] == 255)
+					continue;
+				++covered;
+				colors.insert(px[0] << 16 | px[1] << 8 | px[2]);
+			}
+		if (covered)
+			++filled;
+	}
+	// the empty cells past the last part must stay empty
+	int stray = 0;
+	for (int cell = CHARACTERS * PARTS; cell < GRID * GRID; ++cell) {
+		int x0 = (cell % GRID) * CELL, y0 = SIZE - (cell / GRID + 1) * CELL;
+		for (int y = y0; y < y0 + CELL; ++y)
+			for (int x = x0; x < x0 + CELL; ++x) {
+				const unsigned char* px = &pixels[((size_t)y * SIZE + x) * 4];
+				if (!(px[0] == 255 && px[1] == 0 && px[2] == 255))
+					++stray;
+			}
+	}
+
+	arena.release();
+	shadows.release();
+	glDeleteProgram(shader.Program);
+
+	bool ok = error == GL_NO_ERROR && filled == CHARACTERS * PARTS && stray == 0 && colors.size() > 1;
+	printf("{\n");
+	printf("  \"renderer\": \"%s\",\n", (const char*)glGetString(GL_RENDERER));
+	printf("  \"cells_filled\": %d, \"cells\": %d, \"stray_pixels\": %d,\n", filled, CHARACTERS * PARTS, stray);
+	printf("  \"colors\": %zu, \"gl_error\": %u,\n", colors.size(), error);
+	printf("  \"ok\": %s\n", ok ? "true" : "false");
+	printf("}\n");
+	return ok ? 0 : 1;
+}
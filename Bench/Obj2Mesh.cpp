@@ -0,0 +1,92 @@
+/************************************************************************
+     File:        Obj2Mesh.cpp
+
+     Comment:     Converts .obj models into the binary .mesh files the
+						park loads (see MeshCache.H), ahead of time, so
+						not even the first run has to parse them. Also
+						times the text parse against mapping the .mesh,
+						and reports what MeshOptimize.H did to each one.
+
+						Usage: obj2mesh file.obj ...
+
+*************************************************************************/
+
+#include <stdio.h>
+
+#include <chrono>
+
+#include "../MeshCache.H"
+#include "../MeshOptimize.H"
+#include "../ObjParser.H"
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: obj2mesh file.obj ...\n");
+		return 1;
+	}
+
+	int failed = 0;
+	double parseTotal = 0, optimizeTotal = 0, mapTotal = 0;
+	unsigned int corners = 0, before = 0, after = 0;
+	double missesBefore = 0, missesAfter = 0;
+	for (int i = 1; i < argc; ++i) {
+		const char* obj = argv[i];
+		std::string meshPath = meshCachePath(obj);
+
+		Clock::time_point start = Clock::now();
+		MeshData data;
+		if (!parseOBJ(obj, data)) {
+			++failed;
+			continue;
+		}
+		double parseMs = msSince(start);
+
+		start = Clock::now();
+		MeshStats stats;
+		optimizeMesh(data, &stats);
+		double optimizeMs = msSince(start);
+		if (!writeMeshCache(meshPath.c_str(), data, obj)) {
+			++failed;
+			continue;
+		}
+
+		// map it and touch every page, as the upload would
+		start = Clock::now();
+		MappedMesh mesh;
+		if (!mesh.open(meshPath.c_str())) {
+			++failed;
+			continue;
+		}
+		float sum = 0;
+		const float* v = mesh.vertices();
+		for (size_t k = 0; k < (size_t)mesh.vertexCount() * MESH_VERTEX_FLOATS; k += 1024)
+			sum += v[k];
+		double mapMs = msSince(start);
+
+		printf("%-24s %8u indices %3u ranges  vertices %8u -> %8u  ACMR %.3f -> %.3f  "
+			"parse %8.2f ms  optimize %7.2f ms  map %6.3f ms%s\n",
+			obj, mesh.indexCount(), mesh.rangeCount(), stats.verticesBefore, stats.verticesAfter,
+			stats.acmrBefore, stats.acmrAfter, parseMs, optimizeMs, mapMs, sum == sum ? "" : " (nan)");
+		parseTotal += parseMs;
+		optimizeTotal += optimizeMs;
+		mapTotal += mapMs;
+		corners += stats.corners;
+		before += stats.verticesBefore;
+		after += stats.verticesAfter;
+		missesBefore += stats.acmrBefore * (stats.corners / 3);
+		missesAfter += stats.acmrAfter * (stats.corners / 3);
+	}
+	printf("total: %u corners, vertices %u -> %u, ACMR %.3f -> %.3f, parse %.2f ms, optimize %.2f ms, map %.3f ms\n",
+		corners, before, after, corners ? missesBefore * 3 / corners : 0.0, corners ? missesAfter * 3 / corners : 0.0,
+		parseTotal, optimizeTotal, mapTotal);
+
+	return failed ? 1 : 0;
+}
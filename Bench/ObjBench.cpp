@@ -0,0 +1,202 @@
+/************************************************************************
+     File:        ObjBench.cpp
+
+     Comment:     Times the .obj parser (ObjParser.H) against the fscanf
+						loader it replaced, on the given files.
+
+						Each file is read by the old loader (copied here as
+						it was), then by parseOBJ on one thread and on a
+						pool with one thread per core. The triangles the two
+						parsers give are compared corner by corner, and the
+						times and vertex counts are printed as one JSON
+						object. The old loader only read the first three
+						corners of a face, so files with quads are marked
+						and left out of the comparison.
+
+						Usage: obj_bench [runs] file.obj ...
+
+*************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../ObjParser.H"
+#include "../JobPool.H"
+
+typedef std::chrono::steady_clock Clock;
+
+struct Vec2 { float x, y; };
+struct Vec3 { float x, y, z; };
+
+//****************************************************************************
+//
+// * loadOBJ as it was, with plain structs in place of glm
+//============================================================================
+static bool legacyLoadOBJ(const char* path, std::vector<Vec3>& out_vertices,
+	std::vector<Vec2>& out_uvs, std::vector<Vec3>& out_normals)
+//============================================================================
+{
+	std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
+	std::vector<Vec3> temp_vertices;
+	std::vector<Vec2> temp_uvs;
+	std::vector<Vec3> temp_normals;
+
+	FILE* file = fopen(path, "r");
+	if (file == NULL)
+		return false;
+	while (1) {
+		char lineHeader[128];
+		int res = fscanf(file, "%127s", lineHeader);
+		if (res == EOF)
+			break;
+
+		if (strcmp(lineHeader, "v") == 0) {
+			Vec3 vertex;
+			fscanf(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z);
+			temp_vertices.push_back(vertex);
+		}
+		else if (strcmp(lineHeader, "vt") == 0) {
+			Vec2 uv;
+			fscanf(file, "%f %f\n", &uv.x, &uv.y);
+			temp_uvs.push_back(uv);
+		}
+		else if (strcmp(lineHeader, "vn") == 0) {
+			Vec3 normal;
+			fscanf(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
+			temp_normals.push_back(normal);
+		}
+		else if (strcmp(lineHeader, "f") == 0) {
+			unsigned int vertexIndex[3], uvIndex[3], normalIndex[3];
+			int matches = fscanf(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n", &vertexIndex[0], &uvIndex[0], &normalIndex[0],
+				&vertexIndex[1], &uvIndex[1], &normalIndex[1],
+				&vertexIndex[2], &uvIndex[2], &normalIndex[2]);
+			if (matches != 9) {
+				fclose(file);
+				return false;
+			}
+			for (int k = 0; k < 3; ++k) {
+				vertexIndices.push_back(vertexIndex[k]);
+				uvIndices.push_back(uvIndex[k]);
+				normalIndices.push_back(normalIndex[k]);
+			}
+		}
+		else if (strcmp(lineHeader, "usemtl") == 0) {
+			char material[50];
+			fscanf(file, "%49s", material);
+		}
+		else {
+			char stupidBuffer[1000];
+			fgets(stupidBuffer, 1000, file);
+		}
+	}
+	fclose(file);
+
+	for (unsigned int i = 0; i < vertexIndices.size(); i++) {
+		out_vertices.push_back(temp_vertices[vertexIndices[i] - 1]);
+		out_uvs.push_back(temp_uvs[uvIndices[i] - 1]);
+		out_normals.push_back(temp_normals[normalIndices[i] - 1]);
+	}
+	return true;
+}
+
+//****************************************************************************
+//
+// * biggest difference between the triangles of the two parsers, or -1
+//   if they do not have the same number of corners
+//============================================================================
+static float compare(const MeshData& mesh, const std::vector<Vec3>& positions,
+	const std::vector<Vec2>& uvs, const std::vector<Vec3>& normals)
+//============================================================================
+{
+	if (mesh.indices.size() != positions.size())
+		return -1.0f;
+	float worst = 0;
+	for (size_t i = 0; i < mesh.indices.size(); ++i) {
+		const float* v = &mesh.vertices[(size_t)mesh.indices[i] * MESH_VERTEX_FLOATS];
+		const float old[MESH_VERTEX_FLOATS] = { positions[i].x, positions[i].y, positions[i].z,
+			uvs[i].x, uvs[i].y, normals[i].x, normals[i].y, normals[i].z };
+		for (int k = 0; k < MESH_VERTEX_FLOATS; ++k)
+			worst = std::max(worst, fabsf(v[k] - old[k]));
+	}
+	return worst;
+}
+
+template <typename F>
+static double bestOf(int runs, F f)
+{
+	double best = 1e30;
+	for (int r = 0; r < runs; ++r) {
+		Clock::time_point start = Clock::now();
+		f();
+		best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+	}
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	int first = 1;
+	int runs = 3;
+	if (argc > 1 && atoi(argv[1]) > 0) {
+		runs = atoi(argv[1]);
+		first = 2;
+	}
+	if (first >= argc) {
+		fprintf(stderr, "usage: obj_bench [runs] file.obj ...\n");
+		return 1;
+	}
+
+	JobPool single(1);
+	JobPool& all = JobPool::shared();
+
+	double totalLegacy = 0, totalSingle = 0, totalPool = 0;
+	bool same = true;
+
+	printf("{\n");
+	printf("  \"threads\": %u,\n", all.size());
+	printf("  \"files\": {\n");
+	for (int i = first; i < argc; ++i) {
+		const char* path = argv[i];
+
+		std::vector<Vec3> positions, normals;
+		std::vector<Vec2> uvs;
+		double legacy = bestOf(runs, [&] {
+			positions.clear();
+			uvs.clear();
+			normals.clear();
+			legacyLoadOBJ(path, positions, uvs, normals);
+		});
+
+		MeshData mesh;
+		bool ok = true;
+		double oneThread = bestOf(runs, [&] { ok = parseOBJ(path, mesh, &single); });
+		double pool = bestOf(runs, [&] { ok = parseOBJ(path, mesh, &all) && ok; });
+
+		float diff = ok ? compare(mesh, positions, uvs, normals) : -1.0f;
+		bool legacyShort = ok && diff < 0 && positions.size() < mesh.indices.size();
+		if (!legacyShort)
+			same = same && diff >= 0 && diff < 1e-5f;
+
+		printf("    \"%s\": { \"legacy_ms\": %.2f, \"parse_ms\": %.2f, \"parse_pool_ms\": %.2f, "
+			"\"speedup\": %.1f, \"corners\": %zu, \"vertices\": %u, \"max_diff\": %g%s }%s\n",
+			path, legacy, oneThread, pool, legacy / pool, mesh.indices.size(), mesh.vertexCount(), diff,
+			legacyShort ? ", \"legacy_dropped_corners\": true" : "", i + 1 < argc ? "," : "");
+		totalLegacy += legacy;
+		totalSingle += oneThread;
+		totalPool += pool;
+	}
+	printf("  },\n");
+	printf("  \"total\": { \"legacy_ms\": %.2f, \"parse_ms\": %.2f, \"parse_pool_ms\": %.2f, \"speedup\": %.1f },\n",
+		totalLegacy, totalSingle, totalPool, totalLegacy / totalPool);
+	printf("  \"same_triangles\": %s\n", same ? "true" : "false");
+	printf("}\n");
+
+	return same ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+/************************************************************************
+     File:        ReadbackCheck.cpp
+
+     Comment:     Runs PixelReadback on a headless context and checks
+						what comes back.
+
+						For 20 frames the target is cleared to a color of
+						its own and a block of it is read, polling once a
+						frame as TrainView would; every read that was
+						taken must be called back once, with that frame's
+						color. Then a float read is started from inside
+						the callback of another, which has to come back
+						too, and GL errors are looked for. Prints one
+						JSON object; exits 1 on a failure.
+
+						Usage: readback_check
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "HeadlessGL.H"
+#include "../PixelReadback.H"
+
+#define FRAMES		20
+#define BLOCK_W		7
+#define BLOCK_H		3
+
+int main()
+{
+	if (!makeHeadlessContext())
+		return 1;
+	HeadlessTarget target(64, 64);
+
+	PixelReadback readback;
+	int asked = 0, got = 0, wrong = 0, busy = 0;
+
+	for (int frame = 0; frame < FRAMES; ++frame) {
+		float red = frame / (float)FRAMES;
+		glClearColor(red, 0.5f, 1.0f - red, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+
+		// what GL_UNSIGNED_BYTE makes of the clear color
+		const int wantRed = (int)(red * 255.0f + 0.5f), wantGreen = 128;
+		bool taken = readback.read(3, 5, BLOCK_W, BLOCK_H, GL_RGB, GL_UNSIGNED_BYTE,
+			[&, wantRed](const void* pixels, int width, int height) {
+				const unsigned char* p = (const unsigned char*)pixels;
+				++got;
+				if (width != BLOCK_W || height != BLOCK_H)
+					++wrong;
+				for (int i = 0; i < width * height; ++i)
+					if (abs(p[i * 3] - wantRed) > 1 || abs(p[i * 3 + 1] - wantGreen) > 1)
+						++wrong;
+			});
+		if (taken)
+			++asked;
+		else
+			++busy;		// SLOTS reads still in flight
+		readback.poll();
+	}
+	readback.poll(true);
+
+	// a read started from a callback: the slot it goes into may be the
+	// one being called back
+	glClearColor(0.25f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	bool chained = false;
+	readback.read(0, 0, 1, 1, GL_RGBA, GL_FLOAT, [&](const void*, int, int) {
+		readback.read(0, 0, 2, 2, GL_RED, GL_FLOAT, [&](const void* pixels, int width, int height) {
+			const float* p = (const float*)pixels;
+			chained = width == 2 && height == 2 && fabsf(p[0] - 0.25f) < 0.01f && fabsf(p[3] - 0.25f) < 0.01f;
+		});
+	});
+	readback.poll(true);
+	readback.poll(true);
+
+	GLenum error = glGetError();
+	int left = readback.pending();
+	readback.release();
+
+	bool ok = error == GL_NO_ERROR && asked > 0 && got == asked && wrong == 0 && chained && left == 0;
+	printf("{\n");
+	printf("  \"renderer\": \"%s\",\n", (const char*)glGetString(GL_RENDERER));
+	printf("  \"reads\": %d, \"called_back\": %d, \"busy\": %d, \"wrong_pixels\": %d,\n", asked, got, busy, wrong);
+	printf("  \"chained\": %s, \"pending\": %d, \"gl_error\": %u,\n", chained ? "true" : "false", left, error);
+	printf("  \"ok\": %s\n", ok ? "true" : "false");
+	printf("}\n");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,153 @@
+/************************************************************************
+     File:        SplineBench.cpp
+
+     Comment:     Microbenchmark for the spline evaluation.
+
+						Samples the default track (and a bigger random
+						one) with the old per sample path - pow() for
+						the powers of t, the basis multiplied out for
+						every sample and a heap allocated derivative
+						array - and with evalSplineBatch, for every
+						spline type, and prints the time per sample of
+						both along with the largest difference between
+						their results.
+
+						Usage: spline_bench [samples per segment] [repeats]
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "../Spline.H"
+
+//****************************************************************************
+//
+// * what drawTrack and drawTrain used to do for every sample
+//============================================================================
+static void legacySample(const std::vector<ControlPoint>& points, int type, float u,
+	Pnt3f& qt, Pnt3f& tangent, Pnt3f& orient_t)
+//============================================================================
+{
+	size_t n = points.size();
+	int side = (int)(u * n);
+	float t = u * n - side;
+
+	float T[4]{ (float)pow(t, 3), (float)pow(t, 2), t, 1 };
+	float dT[4]{ 3 * (float)pow(t, 2), 2 * t, 1, 0 };
+	float C[4]{ 0 };
+	float* dif = new float[4]{ 0 };
+
+	const ControlPoint& p1 = points[side];
+	const ControlPoint& p2 = points[(side + 1) % n];
+	const ControlPoint& p3 = points[(side + 2) % n];
+	const ControlPoint& p4 = points[(side + 3) % n];
+
+	if (type == LINEAR) {
+		qt = (1 - t) * p1.pos + t * p2.pos;
+		orient_t = (1 - t) * p1.orient + t * p2.orient;
+		tangent = p2.pos - p1.pos;
+	}
+	else {
+		float (*M)[4] = (type == B_SPLINE) ? M_b_spline : M_cardinal;
+		for (int i = 0; i < 4; ++i)
+			for (int j = 0; j < 4; ++j) {
+				C[i] += M[j][i] * T[j];
+				dif[i] += M[j][i] * dT[j];
+			}
+		qt = p1.pos * C[0] + p2.pos * C[1] + p3.pos * C[2] + p4.pos * C[3];
+		orient_t = p1.orient * C[0] + p2.orient * C[1] + p3.orient * C[2] + p4.orient * C[3];
+		tangent = p1.pos * dif[0] + p2.pos * dif[1] + p3.pos * dif[2] + p4.pos * dif[3];
+	}
+	orient_t.normalize();
+
+	delete[] dif;
+}
+
+//****************************************************************************
+//
+// * fastest of a few runs of f, in nanoseconds per sample
+//============================================================================
+template <typename F>
+static double timeIt(F f, size_t samples, int repeats)
+//============================================================================
+{
+	double best = 1e30;
+	for (int r = 0; r < repeats; ++r) {
+		auto start = std::chrono::steady_clock::now();
+		f();
+		auto end = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count());
+	}
+	return best / samples;
+}
+
+static void runTrack(const char* name, const std::vector<ControlPoint>& points,
+	unsigned int samplesPerSegment, int repeats)
+{
+	const size_t n = points.size() * samplesPerSegment;
+	std::vector<float> u(n);
+	for (size_t i = 0; i < n; ++i)
+		u[i] = (float)i / n;
+
+	std::vector<Pnt3f> pos(n), tan(n), ori(n);
+	std::vector<float> soa(9 * n);
+	SplineSamples out;
+	out.px = &soa[0];		out.py = &soa[n];		out.pz = &soa[2 * n];
+	out.tx = &soa[3 * n];	out.ty = &soa[4 * n];	out.tz = &soa[5 * n];
+	out.ox = &soa[6 * n];	out.oy = &soa[7 * n];	out.oz = &soa[8 * n];
+
+	static const char* typeNames[] = { "", "linear", "cardinal", "b-spline" };
+	for (int type = LINEAR; type <= B_SPLINE; ++type) {
+		double legacy = timeIt([&] {
+			for (size_t i = 0; i < n; ++i)
+				legacySample(points, type, u[i], pos[i], tan[i], ori[i]);
+		}, n, repeats);
+
+		double batch = timeIt([&] {
+			evalSplineBatch(points.data(), points.size(), type, u.data(), n, out);
+		}, n, repeats);
+
+		float err = 0;
+		for (size_t i = 0; i < n; ++i) {
+			err = std::max(err, fabsf(pos[i].x - out.px[i]));
+			err = std::max(err, fabsf(pos[i].y - out.py[i]));
+			err = std::max(err, fabsf(pos[i].z - out.pz[i]));
+			err = std::max(err, fabsf(tan[i].x - out.tx[i]));
+			err = std::max(err, fabsf(ori[i].y - out.oy[i]));
+		}
+
+		printf("%-8s %-9s %8zu samples  legacy %7.2f ns  batch %7.2f ns  x%5.1f  max diff %g\n",
+			name, typeNames[type], n, legacy, batch, legacy / batch, err);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int samplesPerSegment = (argc > 1) ? (unsigned int)atoi(argv[1]) : 500;
+	int repeats = (argc > 2) ? atoi(argv[2]) : 20;
+
+	// the same square CTrack::resetPoints makes
+	std::vector<ControlPoint> square;
+	square.push_back(ControlPoint(Pnt3f(50, 5, 0)));
+	square.push_back(ControlPoint(Pnt3f(0, 5, 50)));
+	square.push_back(ControlPoint(Pnt3f(-50, 5, 0)));
+	square.push_back(ControlPoint(Pnt3f(0, 5, -50)));
+	runTrack("square", square, samplesPerSegment, repeats);
+
+	std::vector<ControlPoint> random;
+	srand(559);
+	for (int i = 0; i < 64; ++i) {
+		Pnt3f p((float)(rand() % 200 - 100), (float)(rand() % 40), (float)(rand() % 200 - 100));
+		Pnt3f o((float)(rand() % 10 - 5), 10.0f, (float)(rand() % 10 - 5));
+		random.push_back(ControlPoint(p, o));
+	}
+	runTrack("random", random, samplesPerSegment, repeats);
+
+	return 0;
+}
@@ -0,0 +1,290 @@
+/************************************************************************
+     File:        TrainBench.cpp
+
+     Comment:     Headless benchmark of the simulation side of the park.
+
+						Loads a track with CTrack::readPoints (or uses the
+						default square) and runs the work a frame does
+						without any window or GL context, stage by stage:
+
+						  spline     - sample the whole track, as the
+						               track mesh does when it rebuilds
+						  arclength  - rebuild the arc length table
+						  train      - move the train along the track and
+						               work out where and how it sits
+						  particles  - one step of the fireworks
+						  particles_100k - one step of a pool kept
+						               topped up to 100000 sparks
+
+						Each stage is timed on every frame and the mean,
+						median and 99th percentile (in microseconds) are
+						printed as one JSON object on stdout, so runs can
+						be compared by a script.
+
+						Then a pool of 500000 sparks is stepped on 1, 2, 4
+						and 8 threads, to see how the particle jobs scale,
+						and the particles left at the end are compared to
+						check every thread count gives the same result.
+						The memory the particle systems hold is also
+						taken after a few warm up frames and again at the
+						end: a step must not allocate, so it may not grow.
+
+						Usage: train_bench [track file] [frames] [spline type]
+						       spline type is 1 linear, 2 cardinal, 3 b-spline
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "../Track.H"
+#include "../Spline.H"
+#include "../ArcLengthTable.H"
+#include "../ParticleSystem.H"
+
+// samples per segment, the same as TrainView::DIVIDE_LINE
+static const unsigned int DIVIDE_LINE = 500;
+
+// what ProcessParticles gets at 60 frames a second (half milliseconds)
+static const float PARTICLE_TICK = 1000.0f / 60.0f * 0.5f;
+
+// live particles in the stress test of the pool
+static const unsigned int STRESS_PARTICLES = 100000;
+
+// the thread scaling test
+static const unsigned int SCALING_PARTICLES = 500000;
+static const unsigned int SCALING_THREADS[] = { 1, 2, 4, 8 };
+static const int SCALING_FRAMES = 100;
+
+// frames before the particle memory is taken as settled
+static const int WARMUP_FRAMES = 10;
+
+// speed slider value the train is driven at
+static const float TRAIN_SPEED = 2.0f;
+
+typedef std::chrono::steady_clock Clock;
+
+struct Stage
+{
+	const char*			name;
+	std::vector<double>	times;		// microseconds, one per frame
+};
+
+//****************************************************************************
+//
+// * time one call of f into the stage
+//============================================================================
+template <typename F>
+static void timeStage(Stage& stage, F f)
+//============================================================================
+{
+	Clock::time_point start = Clock::now();
+	f();
+	Clock::time_point end = Clock::now();
+	stage.times.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+}
+
+//****************************************************************************
+//
+// * nearest rank percentile of sorted times
+//============================================================================
+static double percentile(const std::vector<double>& sorted, double p)
+//============================================================================
+{
+	if (sorted.empty())
+		return 0.0;
+	size_t i = (size_t)(p / 100.0 * sorted.size());
+	return sorted[std::min(i, sorted.size() - 1)];
+}
+
+//****************************************************************************
+//
+// * keep the pool topped up with long lived sparks drifting about
+//============================================================================
+static void topUp(ParticleSystem& particles, unsigned int target)
+//============================================================================
+{
+	Particle spark;
+	spark.r = spark.g = spark.b = 1.0f;
+	spark.life = 1.0f;
+	spark.fade = 0.0001f;
+	spark.size = 0.8f;
+	spark.xpos = spark.ypos = spark.zpos = 0.0f;
+	spark.yspeed = 0.0f;
+	spark.bFire = 0;
+	spark.nExpl = 0;
+	spark.bAddParts = 0;
+	spark.AddCount = spark.AddSpeed = 0.0f;
+
+	while (particles.size() < target) {
+		spark.xspeed = 0.02f - float(rand() % 41) / 1000.0f;
+		spark.zspeed = 0.02f - float(rand() % 41) / 1000.0f;
+		particles.AddParticle(spark);
+	}
+}
+
+//****************************************************************************
+//
+// * sum of every live particle, to tell two runs apart
+//============================================================================
+static double fingerprint(const ParticleSystem& particles)
+//============================================================================
+{
+	double sum = 0;
+	for (unsigned int i = 0; i < particles.size(); ++i)
+		sum += particles.xs()[i] * (i % 7 + 1) + particles.ys()[i] + particles.zs()[i] * (i % 3 + 1);
+	return sum;
+}
+
+static void printStage(Stage& stage, bool last)
+{
+	std::vector<double> sorted = stage.times;
+	std::sort(sorted.begin(), sorted.end());
+
+	double sum = 0;
+	for (double t : sorted)
+		sum += t;
+	double mean = sorted.empty() ? 0.0 : sum / sorted.size();
+
+	printf("    \"%s\": { \"mean_us\": %.3f, \"p50_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f }%s\n",
+		stage.name, mean, percentile(sorted, 50), percentile(sorted, 99),
+		sorted.empty() ? 0.0 : sorted.back(), last ? "" : ",");
+}
+
+int main(int argc, char** argv)
+{
+	const char* trackFile = (argc > 1) ? argv[1] : nullptr;
+	int frames = (argc > 2) ? atoi(argv[2]) : 1000;
+	int splineType = (argc > 3) ? atoi(argv[3]) : CARDINAL;
+	if (frames < 1)
+		frames = 1;
+	if (splineType < LINEAR || splineType > B_SPLINE)
+		splineType = CARDINAL;
+
+	CTrack track;
+	if (trackFile)
+		track.readPoints(trackFile);
+	if (track.points.size() < 4) {
+		fprintf(stderr, "train_bench: no usable track in %s\n", trackFile ? trackFile : "(default)");
+		return 1;
+	}
+
+	// everything the frames need is allocated up front
+	const size_t n = track.points.size() * DIVIDE_LINE;
+	std::vector<float> u(n), soa(6 * n);
+	for (size_t i = 0; i < n; ++i)
+		u[i] = (float)i / n;
+	SplineSamples samples;
+	samples.px = &soa[0];		samples.py = &soa[n];		samples.pz = &soa[2 * n];
+	samples.ox = &soa[3 * n];	samples.oy = &soa[4 * n];	samples.oz = &soa[5 * n];
+
+	ArcLengthTable table;
+	ParticleSystem fireworks;
+	ParticleSystem stress(STRESS_PARTICLES + 10000);
+	srand(559);
+
+	Stage stages[] = { { "spline", {} }, { "arclength", {} }, { "train", {} }, { "particles", {} },
+		{ "particles_100k", {} } };
+	for (Stage& stage : stages)
+		stage.times.reserve(frames);
+
+	float t_time = 0.0f;
+	float checksum = 0.0f;		// keeps the optimizer from dropping the work
+	size_t peakParticles = 0;
+	size_t warmReserved = 0;		// fireworks and stress after the warm up
+
+	for (int frame = 0; frame < frames; ++frame) {
+		if (frame == std::min(WARMUP_FRAMES, frames - 1))
+			warmReserved = fireworks.reserved() + stress.reserved();
+
+		timeStage(stages[0], [&] {
+			evalSplineBatch(track.points.data(), track.points.size(), splineType, u.data(), n, samples);
+		});
+		checksum += samples.px[frame % n];
+
+		timeStage(stages[1], [&] {
+			table.invalidate();
+			table.update(track, splineType, DIVIDE_LINE);
+		});
+
+		timeStage(stages[2], [&] {
+			float s_time = table.lengthAt(t_time) + TRAIN_SPEED * 3.0f;
+			t_time = table.paramAt(s_time);
+
+			Pnt3f qt, tangent, orient_t;
+			evalSpline(track.points, splineType, t_time, qt, tangent, orient_t);
+			float angle_y, angle;
+			trackAngles(tangent, orient_t, angle_y, angle);
+			checksum += qt.x + angle_y + angle;
+		});
+
+		timeStage(stages[3], [&] {
+			fireworks.update(PARTICLE_TICK);
+		});
+		peakParticles = std::max(peakParticles, (size_t)fireworks.size());
+
+		topUp(stress, STRESS_PARTICLES);
+		timeStage(stages[4], [&] {
+			stress.update(PARTICLE_TICK);
+		});
+		checksum += stress.ys()[frame % stress.size()];
+	}
+	bool grew = fireworks.reserved() + stress.reserved() != warmReserved;
+
+	// the same 500000 sparks and the same steps on each number of threads
+	const size_t nScaling = sizeof(SCALING_THREADS) / sizeof(SCALING_THREADS[0]);
+	double scalingMean[nScaling], scalingPrint[nScaling];
+	for (size_t t = 0; t < nScaling; ++t) {
+		JobPool pool(SCALING_THREADS[t]);
+		ParticleSystem sparks(SCALING_PARTICLES + 50000, &pool);
+		srand(559);
+		Stage stage = { "scaling", {} };
+		size_t reserved = 0;
+		for (int frame = 0; frame < SCALING_FRAMES; ++frame) {
+			if (frame == WARMUP_FRAMES)
+				reserved = sparks.reserved();
+			topUp(sparks, SCALING_PARTICLES);
+			timeStage(stage, [&] {
+				sparks.update(PARTICLE_TICK);
+			});
+		}
+		double sum = 0;
+		for (double us : stage.times)
+			sum += us;
+		scalingMean[t] = sum / stage.times.size();
+		scalingPrint[t] = fingerprint(sparks);
+		grew = grew || sparks.reserved() != reserved;
+	}
+
+	printf("{\n");
+	printf("  \"track\": \"%s\",\n", trackFile ? trackFile : "default");
+	printf("  \"control_points\": %zu,\n", track.points.size());
+	printf("  \"spline_type\": %d,\n", splineType);
+	printf("  \"frames\": %d,\n", frames);
+	printf("  \"track_length\": %.3f,\n", table.length());
+	printf("  \"peak_particles\": %zu,\n", peakParticles);
+	printf("  \"particle_memory_grew\": %s,\n", grew ? "true" : "false");
+	printf("  \"checksum\": %g,\n", checksum);
+	printf("  \"stages\": {\n");
+	const size_t nStages = sizeof(stages) / sizeof(stages[0]);
+	for (size_t i = 0; i < nStages; ++i)
+		printStage(stages[i], i + 1 == nStages);
+	printf("  },\n");
+	printf("  \"scaling_%u\": {\n", SCALING_PARTICLES);
+	for (size_t t = 0; t < nScaling; ++t)
+		printf("    \"%u\": { \"mean_us\": %.3f, \"speedup\": %.2f }%s\n",
+			SCALING_THREADS[t], scalingMean[t], scalingMean[0] / scalingMean[t], ",");
+	bool same = true;
+	for (size_t t = 1; t < nScaling; ++t)
+		same = same && scalingPrint[t] == scalingPrint[0];
+	printf("    \"deterministic\": %s\n", same ? "true" : "false");
+	printf("  }\n");
+	printf("}\n");
+
+	// a step that allocated fails the run
+	return grew ? 1 : 0;
+}
@@ -0,0 +1,19 @@
+/************************************************************************
+     File:        glad.h
+
+     Comment:     Stands in for the glad loader in the headless checks.
+
+						They link the system's libOpenGL, which exports the
+						whole core API on Linux, so the prototypes are all
+						they need. Only for the Bench targets that draw;
+						the project itself builds with the real loader.
+
+*************************************************************************/
+#pragma once
+
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+// everything up to 4.5 is there
+#define GLAD_GL_VERSION_4_4 1
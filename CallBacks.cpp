@@ -74,6 +74,7 @@ void addPointCB(Fl_Widget*, TrainWindow* tw)
 	Pnt3f npos = (tw->m_Track.points[previdx].pos + tw->m_Track.points[newidx].pos) * .5f;
 
 	tw->m_Track.points.insert(tw->m_Track.points.begin() + newidx,npos);
+	tw->m_Track.pointsChanged();
 
 	// make it so that the train doesn't move - unless its affected by this control point
 	// it should stay between the same points
@@ -97,6 +98,7 @@ void deletePointCB(Fl_Widget*, TrainWindow* tw)
 			tw->m_Track.points.erase(tw->m_Track.points.begin() + tw->trainView->selectedCube);
 		} else
 			tw->m_Track.points.pop_back();
+		tw->m_Track.pointsChanged();
 	}
 	tw->damageMe();
 }
@@ -122,25 +124,44 @@ void backCB(Fl_Widget*, TrainWindow* tw)
 
 
 
-static unsigned long lastRedraw = 0;
+// the steps a second advanceTrain's distances were set for
+static const float TRAIN_HZ = 30.0f;
+
 //***************************************************************************
 //
 // * Callback for idling - if things are sitting, this gets called
-// if the run button is pushed, then we need to make the train go.
-// This is taken from the old "RunButton" demo.
-// another nice problem to have - most likely, we'll be too fast
-// don't draw more than 30 times per second
+// The clock says how many fixed steps are due; the train (if the run
+// button is pushed), the fireworks and the ripples take each of them,
+// so they move the same whatever the frame rate. While running, the
+// view is redrawn as often as it can be, in between the steps.
 //===========================================================================
 void runButtonCB(TrainWindow* tw)
 //===========================================================================
 {
-	if (tw->runButton->value()) {	// only advance time if appropriate
-		if (clock() - lastRedraw > CLOCKS_PER_SEC/30) {
-			lastRedraw = clock();
-			tw->advanceTrain();
-			tw->damageMe();
-		}
-	}
+	SimClock& clock = tw->simClock;
+	clock.paused = tw->pauseButton->value() != 0;
+	clock.scale = (float)tw->timeScale->value();
+	clock.setRate((float)tw->simRate->value());
+
+	int steps = clock.advance();
+	if (tw->runButton->value())	// only move the train if appropriate
+		for (int i = 0; i < steps; ++i)
+			tw->advanceTrain(TRAIN_HZ / clock.rate());
+	tw->trainView->particleSteps += steps;
+	tw->trainView->waterSteps += steps;
+
+	if (steps || (tw->runButton->value() && !clock.paused))
+		tw->damageMe();
+}
+
+//***************************************************************************
+//
+// *
+//===========================================================================
+void stepCB(Fl_Widget*, TrainWindow* tw)
+//===========================================================================
+{
+	tw->simClock.step();
 }
 
 //***************************************************************************
@@ -170,6 +191,19 @@ void saveCB(Fl_Widget*, TrainWindow* tw)
 		tw->m_Track.writePoints(fname);
 }
 
+//***************************************************************************
+//
+// * Save the stage timings of the last frames
+//===========================================================================
+void profileCB(Fl_Widget*, TrainWindow* tw)
+//===========================================================================
+{
+	const char* fname =
+		fl_input("File name for the frame times (*.csv)", "profile.csv");
+	if (fname && !tw->trainView->profiler.dumpCSV(fname))
+		fl_alert("Can't write %s", fname);
+}
+
 //***************************************************************************
 //
 // * Rotate the selected control point about x axis
@@ -183,6 +217,7 @@ void rollx(TrainWindow* tw, float dir)
 		float co = cos(((float)M_PI_4) * dir);
 		tw->m_Track.points[s].orient.y = co * old.y - si * old.z;
 		tw->m_Track.points[s].orient.z = si * old.y + co * old.z;
+		tw->m_Track.pointsChanged();
 	}
 	tw->damageMe();
 } 
@@ -223,6 +258,7 @@ void rollz(TrainWindow* tw, float dir)
 
 		tw->m_Track.points[s].orient.y = co * old.y - si * old.x;
 		tw->m_Track.points[s].orient.x = si * old.y + co * old.x;
+		tw->m_Track.pointsChanged();
 	}
 
 	tw->damageMe();
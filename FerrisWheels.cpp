@@ -1,210 +1,282 @@
+/************************************************************************
+     File:        FerrisWheels.cpp
+
+     Comment:     The ferris wheel, instanced. See FerrisWheels.H
+
+*************************************************************************/
+
 #include "FerrisWheels.H"
+#include "Primitives.H"
+#include "RenderUtilities/Shader.h"
+
 #define PI 3.1415926
 
-Carriage::
-Carriage()
-{
-}
+// the sides of the wheel are this far either side of the middle
+#define SIDE_OFFSET 1.8f
 
-Carriage::
-Carriage(glm::vec3 p)
-	:position(p), radius(1.0f), slices(50.0f), stacks(50.0f)
+// room each carriage takes on the circle
+#define CARRIAGE_SPACING 2.6f
+
+//****************************************************************************
+//
+// * turn the vertices from first on a quarter about x, as glRotatef(90,
+//   1, 0, 0) would (y becomes z), and move them along z
+//============================================================================
+static void layOnZ(std::vector<float>& vertices, size_t first, float z)
+//============================================================================
 {
-	color = new float[3]{ 255, 255, 255 };
+	for (size_t i = first; i < vertices.size(); i += PRIMITIVE_VERTEX_FLOATS) {
+		float* v = &vertices[i];
+		float y = v[1], ny = v[4];
+		v[1] = -v[2];
+		v[2] = y + z;
+		v[4] = -v[5];
+		v[5] = ny;
+	}
 }
 
-glm::vec3 Carriage::
-getPosition()
+//****************************************************************************
+//
+// * a flat triangle
+//============================================================================
+static void triangle(const float* a, const float* b, const float* c,
+	std::vector<float>& vertices, std::vector<unsigned int>& indices)
+//============================================================================
 {
-	return position;
+	float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+	float w[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+	float n[3] = { u[1] * w[2] - u[2] * w[1], u[2] * w[0] - u[0] * w[2], u[0] * w[1] - u[1] * w[0] };
+	float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+	const unsigned int first = (unsigned int)(vertices.size() / PRIMITIVE_VERTEX_FLOATS);
+	const float* corners[3] = { a, b, c };
+	for (int k = 0; k < 3; ++k) {
+		const float v[PRIMITIVE_VERTEX_FLOATS] = { corners[k][0], corners[k][1], corners[k][2],
+			n[0] / length, n[1] / length, n[2] / length };
+		vertices.insert(vertices.end(), v, v + PRIMITIVE_VERTEX_FLOATS);
+		indices.push_back(first + k);
+	}
 }
 
-float* Carriage::
-getColor()
+//****************************************************************************
+//
+// * a column major matrix turning by angle degrees about z, then moving
+//   to (x, y, z)
+//============================================================================
+static void turnAndMove(float* m, double angle, float x, float y, float z)
+//============================================================================
 {
-	return color;
+	float c = (float)cos(angle * PI / 180.0), s = (float)sin(angle * PI / 180.0);
+	const float r[16] = {
+		c,    s,    0.0f, 0.0f,
+		-s,   c,    0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		x,    y,    z,    1.0f };
+	for (int k = 0; k < 16; ++k)
+		m[k] = r[k];
 }
 
+//****************************************************************************
+//
+// * Constructor
+//============================================================================
 FerrisWheel::
-FerrisWheel()
-	:radius(4.0f)
+FerrisWheel(unsigned int carriages)
+	: carriageCount(0), wheelRadius(5.0f), builtTime(-1.0),
+	  vao(0), vbo(0), ebo(0), instances(0), capacity(0)
+//============================================================================
 {
-	//carriages
-	float c_radius = 5.0f;
-	float c_angle = 0.0f;
-
-	for (int i = 0; i < 12; ++i)
-	{
-		glm::vec2 pos = glm::vec2(0.0f, 0.0f);
-		c_angle = i * 30;
-
-		pos.x = c_radius * sinf(c_angle * PI / 180);
-		pos.y = c_radius * cosf(c_angle * PI / 180);
-
-		addCarriage(pos);
-	}
+	legs.first = legs.count = 0;
+	side.first = side.count = 0;
+	carriage.first = carriage.count = 0;
+	setCarriages(carriages);
 }
 
+//****************************************************************************
+//
+// * a wheel of 12 has a radius of 5; bigger ones grow to keep the
+//   carriages apart. The geometry is built again on the next draw
+//============================================================================
 void FerrisWheel::
-addCarriage(glm::vec2 pos)
+setCarriages(unsigned int n)
+//============================================================================
 {
-	Carriage newCarriage(glm::vec3(pos, 0.0f));
-
-	carriages.push_back(newCarriage);
+	carriageCount = n;
+	float fit = (float)(n * CARRIAGE_SPACING / (2 * PI));
+	wheelRadius = fit > 5.0f ? fit : 5.0f;
+	release();
 }
 
+//****************************************************************************
+//
+// * the legs, a side and a carriage, into one buffer
+//============================================================================
 void FerrisWheel::
-drawCarriage()
+create()
+//============================================================================
 {
-	GLUquadric* q = gluNewQuadric();
-	gluSphere(q, 1, 50, 50);
+	std::vector<float> vertices;
+	std::vector<unsigned int> indices;
+
+	// the legs go from the hub down to the ground, and out
+	const float k = wheelRadius / 5.0f;
+	const float ground = -height();
+	legs.first = (unsigned int)indices.size();
+	for (int s = -1; s <= 1; s += 2)
+		for (int x = -1; x <= 1; x += 2) {
+			const float top[3] = { 0.0f, -2.0f * k, 2.8f * s };
+			const float outer[3] = { 5.0f * k * x, ground, 4.8f * s };
+			const float inner[3] = { 3.0f * k * x, ground, 4.8f * s };
+			triangle(top, outer, inner, vertices, indices);
+		}
+	legs.count = (unsigned int)indices.size() - legs.first;
+
+	// the hub, and a rim either side of it
+	side.first = (unsigned int)indices.size();
+	size_t start = vertices.size();
+	buildCylinder(0.8f * wheelRadius, -1.0f, 1.0f, 64, true, vertices, indices);
+	layOnZ(vertices, start, 0.0f);
+	for (int s = -1; s <= 1; s += 2) {
+		start = vertices.size();
+		buildTorus(wheelRadius + 1.0f, 0.6f, 64, 16, vertices, indices);
+		layOnZ(vertices, start, (float)s);
+	}
+	side.count = (unsigned int)indices.size() - side.first;
+
+	carriage.first = (unsigned int)indices.size();
+	buildSphere(1.0f, 32, 16, vertices, indices);
+	carriage.count = (unsigned int)indices.size() - carriage.first;
+
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(1, &vbo);
+	glGenBuffers(1, &ebo);
+	glGenBuffers(1, &instances);
+
+	glBindVertexArray(vao);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+	const GLsizei stride = PRIMITIVE_VERTEX_FLOATS * sizeof(float);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+	// a mat4 per instance takes four attribute locations, one per column
+	glBindBuffer(GL_ARRAY_BUFFER, instances);
+	for (int c = 0; c < 4; ++c) {
+		glVertexAttribPointer(3 + c, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float), (GLvoid*)(c * 4 * sizeof(float)));
+		glEnableVertexAttribArray(3 + c);
+		glVertexAttribDivisor(3 + c, 1);
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	builtTime = -1.0;
 }
 
+//****************************************************************************
+//
+// * the transforms of every part at time. The front side turns one way
+//   and the back side the other, each with its carriages
+//============================================================================
 void FerrisWheel::
-draw(bool doingShadows, double time)
+update(double time)
+//============================================================================
 {
-	glPushMatrix();
-	glTranslatef(0.0f, 0.0f, 1.8f);
-	glRotatef(time * 360, 0.0f, 0.0f, 1.0f);
-	drawWheel(doingShadows);
-	glPopMatrix();
-
-	glPushMatrix();
-	glTranslatef(0.0f, 0.0f, -1.8f);
-	glRotatef(-time * 360, 0.0f, 0.0f, 1.0f);
-	drawWheel(doingShadows);
-	glPopMatrix();
-
-	glBegin(GL_TRIANGLES);
-	if (!doingShadows)
-		glColor3ub(255, 255, 255);
-	glVertex3f(0.0f, -2.0f, 2.8f);
-	glVertex3f(-5.0f, -7.0f, 4.8f);
-	glVertex3f(-3.0f, -7.0f, 4.8f);
-	glEnd();
-
-	glBegin(GL_TRIANGLES);
-	if (!doingShadows)
-		glColor3ub(255, 255, 255);
-	glVertex3f(0.0f, -2.0f, 2.8f);
-	glVertex3f(5.0f, -7.0f, 4.8f);
-	glVertex3f(3.0f, -7.0f, 4.8f);
-	glEnd();
-
-	glBegin(GL_TRIANGLES);
-	if (!doingShadows)
-		glColor3ub(255, 255, 255);
-	glVertex3f(0.0f, -2.0f, -2.8f);
-	glVertex3f(-5.0f, -7.0f, -4.8f);
-	glVertex3f(-3.0f, -7.0f, -4.8f);
-	glEnd();
-
-	glBegin(GL_TRIANGLES);
-	if (!doingShadows)
-		glColor3ub(255, 255, 255);
-	glVertex3f(0.0f, -2.0f, -2.8f);
-	glVertex3f(5.0f, -7.0f, -4.8f);
-	glVertex3f(3.0f, -7.0f, -4.8f);
-	glEnd();
-
-	
+	if (time == builtTime)
+		return;
+	builtTime = time;
+
+	const unsigned int count = 3 + 2 * carriageCount;
+	transforms.resize((size_t)count * 16);
+	float* m = transforms.data();
+
+	turnAndMove(m, 0.0, 0.0f, 0.0f, 0.0f);
+	m += 16;
+	for (int s = 1; s >= -1; s -= 2) {
+		turnAndMove(m, s * time * 360, 0.0f, 0.0f, s * SIDE_OFFSET);
+		m += 16;
+	}
+	for (int s = 1; s >= -1; s -= 2)
+		for (unsigned int i = 0; i < carriageCount; ++i) {
+			double a = (i * 360.0 / carriageCount - s * time * 360) * PI / 180.0;
+			turnAndMove(m, 0.0, wheelRadius * (float)sin(a), wheelRadius * (float)cos(a), s * SIDE_OFFSET);
+			m += 16;
+		}
+
+	// orphaned, so the driver need not wait for the frame before
+	glBindBuffer(GL_ARRAY_BUFFER, instances);
+	if (count > capacity)
+		capacity = count;
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)capacity * 16 * sizeof(float), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, transforms.size() * sizeof(float), transforms.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
+//****************************************************************************
+//
+// *
+//============================================================================
 void FerrisWheel::
-drawWheel(bool doingShadows)
+draw(bool doingShadows, double time, Shader* instanceShader)
+//============================================================================
 {
-	//draw carriages
-	for (int i = 0; i < carriages.size(); ++i)
-	{
-		glPushMatrix();
-		glTranslatef(carriages[i].getPosition().x, carriages[i].getPosition().y, carriages[i].getPosition().z);
-		if (!doingShadows)
-			glColor3fv(carriages[i].getColor());
-		drawCarriage();
-		glPopMatrix();
-	}
+	if (!instanceShader)
+		return;
 
-	glBegin(GL_TRIANGLE_FAN);
-	if (!doingShadows)
-		glColor3ub(0, 0, 0);
-	glVertex3f(0.0f, 0.0f, 1.0f);
-	for (int i = 0; i <= 360; ++i)
-		glVertex3f(radius * sinf(i * PI / 180), radius * cosf(i * PI / 180), 1.0f);
-	glEnd();
-
-	glBegin(GL_TRIANGLE_FAN);
-	if (!doingShadows)
-		glColor3ub(0, 0, 0);
-	glVertex3f(0.0f, 0.0f, -1.0f);
-	for (int i = 0; i <= 360; ++i)
-		glVertex3f(radius * sinf(i * PI / 180), radius * cosf(i * PI / 180), -1.0f);
-	glEnd();
-
-	glBegin(GL_TRIANGLE_STRIP);
-	if (!doingShadows)
-		glColor3ub(0, 0, 0);
-	for (int i = 0; i <= 360; ++i)
-	{
-		glVertex3f(radius * sinf(i * PI / 180.0), radius * cosf(i * PI / 180.0), 1.0f);
-		glVertex3f(radius * sinf(i * PI / 180.0), radius * cosf(i * PI / 180.0), -1.0f);
-	}
-	glEnd();
-
-	//draw Torus
-	glPushMatrix();
-	glTranslatef(0.0f, 0.0f, 1.0f);
-	glScalef(12.0f, 12.0f, 12.0f);
-	if (!doingShadows)
-		glColor3ub(0, 0, 0);
-	drawTorus(0.05, 0.50, 32, 32);
-	glPopMatrix();
-
-	glPushMatrix();
-	glTranslatef(0.0f, 0.0f, -1.0f);
-	glScalef(12.0f, 12.0f, 12.0f);
-	if (!doingShadows)
-		glColor3ub(0, 0, 0);
-	drawTorus(0.05, 0.50, 360, 360);
-	glPopMatrix();
+	if (!vao)
+		create();
+	update(time);
+
+	const GLfloat white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	const GLfloat black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+	GLfloat view_matrix[16];
+	GLfloat projection_matrix[16];
+	glGetFloatv(GL_MODELVIEW_MATRIX, view_matrix);
+	glGetFloatv(GL_PROJECTION_MATRIX, projection_matrix);
+
+	instanceShader->Use();
+	instanceShader->setMat4("u_view", view_matrix);
+	instanceShader->setMat4("u_projection", projection_matrix);
+	instanceShader->setInt("u_shadow", doingShadows);
+
+	glBindVertexArray(vao);
+
+	instanceShader->setVec4("u_color", white);
+	glDrawElementsInstancedBaseInstance(GL_TRIANGLES, legs.count, GL_UNSIGNED_INT,
+		(GLvoid*)(legs.first * sizeof(unsigned int)), 1, 0);
+	if (carriageCount)
+		glDrawElementsInstancedBaseInstance(GL_TRIANGLES, carriage.count, GL_UNSIGNED_INT,
+			(GLvoid*)(carriage.first * sizeof(unsigned int)), 2 * carriageCount, 3);
+
+	instanceShader->setVec4("u_color", black);
+	glDrawElementsInstancedBaseInstance(GL_TRIANGLES, side.count, GL_UNSIGNED_INT,
+		(GLvoid*)(side.first * sizeof(unsigned int)), 2, 1);
+
+	glBindVertexArray(0);
+	glUseProgram(0);
 }
 
+//****************************************************************************
+//
+// *
+//============================================================================
 void FerrisWheel::
-drawTorus(GLdouble innerRadius, GLdouble outerRadius, GLint nsides, GLint rings)
+release()
+//============================================================================
 {
-	int i, j;
-	GLfloat theta, phi, theta1;
-	GLfloat cosTheta, sinTheta;
-	GLfloat cosTheta1, sinTheta1;
-	GLfloat ringDelta, sideDelta;
-
-	ringDelta = 2.0 * PI / rings;
-	sideDelta = 2.0 * PI / nsides;
-
-	theta = 0.0;
-	cosTheta = 1.0;
-	sinTheta = 0.0;
-	for (i = rings - 1; i >= 0; i--) {
-		theta1 = theta + ringDelta;
-		cosTheta1 = cos(theta1);
-		sinTheta1 = sin(theta1);
-		glBegin(GL_QUAD_STRIP);
-		phi = 0.0;
-		for (j = nsides; j >= 0; j--) {
-			GLfloat cosPhi, sinPhi, dist;
-
-			phi += sideDelta;
-			cosPhi = cos(phi);
-			sinPhi = sin(phi);
-			dist = outerRadius + innerRadius * cosPhi;
-
-			glNormal3f(cosTheta1 * cosPhi, -sinTheta1 * cosPhi, sinPhi);
-			glVertex3f(cosTheta1 * dist, -sinTheta1 * dist, innerRadius * sinPhi);
-			glNormal3f(cosTheta * cosPhi, -sinTheta * cosPhi, sinPhi);
-			glVertex3f(cosTheta * dist, -sinTheta * dist, innerRadius * sinPhi);
-		}
-		glEnd();
-		theta = theta1;
-		cosTheta = cosTheta1;
-		sinTheta = sinTheta1;
-	}
-}
\ No newline at end of file
+	if (vao)
+		glDeleteVertexArrays(1, &vao);
+	GLuint buffers[] = { vbo, ebo, instances };
+	for (GLuint b : buffers)
+		if (b)
+			glDeleteBuffers(1, &b);
+	vao = vbo = ebo = instances = 0;
+	capacity = 0;
+	builtTime = -1.0;
+}
@@ -0,0 +1,262 @@
+/************************************************************************
+     File:        Forest.cpp
+
+     Comment:     Instanced trees with levels of detail. See Forest.H
+
+*************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+
+#include "Forest.H"
+#include "Primitives.H"
+#include "RenderUtilities/Shader.h"
+
+#define PI 3.1415926f
+
+// sides of the cones and of the trunk at each level
+static const int LEAF_SIDES[FOREST_LODS] = { 32, 12, 6 };
+static const int TRUNK_SIDES[FOREST_LODS] = { 12, 6, 4 };
+
+// the three cones of leaves, from the top: height of the base and radius
+// (each is as high as it is wide). The tree stands on y = 0
+static const float CONES[3][2] = { { 17.0f, 5.0f }, { 12.0f, 8.0f }, { 7.0f, 10.0f } };
+#define TRUNK_RADIUS	2.0f
+#define TRUNK_HEIGHT	10.0f
+
+//****************************************************************************
+//
+// * Constructor
+//============================================================================
+Forest::
+Forest()
+	: vao(0), vbo(0), ebo(0), instances(0), capacity(0), sorted(false)
+//============================================================================
+{
+	lodDistance[0] = 150.0f;
+	lodDistance[1] = 300.0f;
+	for (int l = 0; l < FOREST_LODS; ++l) {
+		levelTrees[l] = 0;
+		levels[l].leafFirst = levels[l].leafCount = 0;
+		levels[l].trunkFirst = levels[l].trunkCount = 0;
+	}
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+bool Forest::
+load(const char* path)
+//============================================================================
+{
+	FILE* fp = fopen(path, "r");
+	if (!fp) {
+		printf("Can't read %s\n", path);
+		return false;
+	}
+
+	char line[256];
+	while (fgets(line, sizeof(line), fp)) {
+		float x, z, scale = 1.0f, angle = 0.0f;
+		if (line[0] == '#')
+			continue;
+		if (sscanf(line, "%f %f %f %f", &x, &z, &scale, &angle) >= 2)
+			add(x, z, scale, angle);
+	}
+	fclose(fp);
+	return true;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void Forest::
+add(float x, float z, float scale, float angle)
+//============================================================================
+{
+	Placement p;
+	p.x = x;
+	p.z = z;
+	p.scale = scale;
+	p.angle = angle * PI / 180.0f;
+	trees.push_back(p);
+	sorted = false;
+}
+
+//****************************************************************************
+//
+// * build every level of the tree into the buffers
+//============================================================================
+void Forest::
+create()
+//============================================================================
+{
+	std::vector<float> vertices;
+	std::vector<unsigned int> indices;
+	for (int l = 0; l < FOREST_LODS; ++l) {
+		levels[l].leafFirst = (unsigned int)indices.size();
+		for (int c = 0; c < 3; ++c)
+			buildCone(CONES[c][1], CONES[c][1], CONES[c][0], LEAF_SIDES[l], vertices, indices);
+		levels[l].leafCount = (unsigned int)indices.size() - levels[l].leafFirst;
+
+		levels[l].trunkFirst = (unsigned int)indices.size();
+		buildCylinder(TRUNK_RADIUS, 0.0f, TRUNK_HEIGHT, TRUNK_SIDES[l], false, vertices, indices);
+		levels[l].trunkCount = (unsigned int)indices.size() - levels[l].trunkFirst;
+	}
+
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(1, &vbo);
+	glGenBuffers(1, &ebo);
+	glGenBuffers(1, &instances);
+
+	glBindVertexArray(vao);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+	const GLsizei stride = PRIMITIVE_VERTEX_FLOATS * sizeof(float);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+	// a mat4 per tree takes four attribute locations, one per column
+	glBindBuffer(GL_ARRAY_BUFFER, instances);
+	for (int c = 0; c < 4; ++c) {
+		glVertexAttribPointer(3 + c, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float), (GLvoid*)(c * 4 * sizeof(float)));
+		glEnableVertexAttribArray(3 + c);
+		glVertexAttribDivisor(3 + c, 1);
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+//****************************************************************************
+//
+// * put the transforms of the trees in the instance buffer, one run per
+//   level. The eye is where the (rigid) modelview puts the origin
+//============================================================================
+void Forest::
+sortByDistance(const GLfloat* m)
+//============================================================================
+{
+	const float eye[3] = {
+		-(m[0] * m[12] + m[1] * m[13] + m[2] * m[14]),
+		-(m[4] * m[12] + m[5] * m[13] + m[6] * m[14]),
+		-(m[8] * m[12] + m[9] * m[13] + m[10] * m[14]) };
+
+	std::vector<unsigned char> level(trees.size());
+	for (int l = 0; l < FOREST_LODS; ++l)
+		levelTrees[l] = 0;
+	for (size_t i = 0; i < trees.size(); ++i) {
+		float dx = trees[i].x - eye[0], dy = eye[1], dz = trees[i].z - eye[2];
+		float d2 = dx * dx + dy * dy + dz * dz;
+		int l = 0;
+		while (l < FOREST_LODS - 1 && d2 > lodDistance[l] * lodDistance[l])
+			++l;
+		level[i] = (unsigned char)l;
+		++levelTrees[l];
+	}
+
+	unsigned int next[FOREST_LODS];
+	next[0] = 0;
+	for (int l = 1; l < FOREST_LODS; ++l)
+		next[l] = next[l - 1] + levelTrees[l - 1];
+
+	transforms.resize(trees.size() * 16);
+	for (size_t i = 0; i < trees.size(); ++i) {
+		const Placement& p = trees[i];
+		float c = cosf(p.angle) * p.scale, s = sinf(p.angle) * p.scale;
+		const float m[16] = {
+			c,    0.0f,    -s,   0.0f,
+			0.0f, p.scale, 0.0f, 0.0f,
+			s,    0.0f,    c,    0.0f,
+			p.x,  0.0f,    p.z,  1.0f };
+		float* dst = &transforms[(size_t)next[level[i]]++ * 16];
+		for (int k = 0; k < 16; ++k)
+			dst[k] = m[k];
+	}
+
+	// orphaned, so the driver need not wait for the frame before
+	glBindBuffer(GL_ARRAY_BUFFER, instances);
+	if (trees.size() > capacity)
+		capacity = (unsigned int)trees.size();
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)capacity * 16 * sizeof(float), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, transforms.size() * sizeof(float), transforms.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	sorted = true;
+}
+
+//****************************************************************************
+//
+// * the leaves of every level, then the trunks, so the color only
+//   changes once
+//============================================================================
+void Forest::
+draw(bool doingShadows, Shader* instanceShader)
+//============================================================================
+{
+	if (trees.empty() || !instanceShader)
+		return;
+
+	if (!vao)
+		create();
+
+	GLfloat view_matrix[16];
+	GLfloat projection_matrix[16];
+	glGetFloatv(GL_MODELVIEW_MATRIX, view_matrix);
+	glGetFloatv(GL_PROJECTION_MATRIX, projection_matrix);
+
+	if (!doingShadows || !sorted)
+		sortByDistance(view_matrix);
+
+	const GLfloat leaves[4] = { 0.0f, 80 / 255.0f, 0.0f, 1.0f };
+	const GLfloat trunk[4] = { 50 / 255.0f, 50 / 255.0f, 10 / 255.0f, 1.0f };
+
+	instanceShader->Use();
+	instanceShader->setMat4("u_view", view_matrix);
+	instanceShader->setMat4("u_projection", projection_matrix);
+	instanceShader->setInt("u_shadow", doingShadows);
+
+	glBindVertexArray(vao);
+	for (int part = 0; part < 2; ++part) {
+		instanceShader->setVec4("u_color", part ? trunk : leaves);
+		unsigned int base = 0;
+		for (int l = 0; l < FOREST_LODS; ++l) {
+			if (levelTrees[l]) {
+				unsigned int first = part ? levels[l].trunkFirst : levels[l].leafFirst;
+				unsigned int count = part ? levels[l].trunkCount : levels[l].leafCount;
+				glDrawElementsInstancedBaseInstance(GL_TRIANGLES, count, GL_UNSIGNED_INT,
+					(GLvoid*)(first * sizeof(unsigned int)), levelTrees[l], base);
+			}
+			base += levelTrees[l];
+		}
+	}
+	glBindVertexArray(0);
+
+	glUseProgram(0);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void Forest::
+release()
+//============================================================================
+{
+	if (vao)
+		glDeleteVertexArrays(1, &vao);
+	GLuint buffers[] = { vbo, ebo, instances };
+	for (GLuint b : buffers)
+		if (b)
+			glDeleteBuffers(1, &b);
+	vao = vbo = ebo = instances = 0;
+	capacity = 0;
+	sorted = false;
+}
@@ -0,0 +1,232 @@
+/************************************************************************
+     File:        HeightField.cpp
+
+     Comment:     Rays against a height field. See HeightField.H
+
+*************************************************************************/
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "HeightField.H"
+
+//****************************************************************************
+//
+// * Constructor
+//============================================================================
+HeightField::
+HeightField()
+	: n(0), cell(0)
+//============================================================================
+{
+}
+
+//****************************************************************************
+//
+// * the squares are level 0; every level above has half as many nodes a
+//   side (rounded up), each the bounds of the up to four under it
+//============================================================================
+void HeightField::
+set(unsigned int size, const float* heights)
+//============================================================================
+{
+	levels.clear();
+	n = size;
+	if (n < 2)
+		return;
+	height.assign(heights, heights + (size_t)n * n);
+	cell = 2.0f / (n - 1);
+
+	Level squares;
+	squares.size = n - 1;
+	squares.lo.resize((size_t)squares.size * squares.size);
+	squares.hi.resize(squares.lo.size());
+	for (unsigned int j = 0; j < squares.size; ++j)
+		for (unsigned int i = 0; i < squares.size; ++i) {
+			const float* h = &height[(size_t)j * n + i];
+			squares.lo[(size_t)j * squares.size + i] = std::min(std::min(h[0], h[1]), std::min(h[n], h[n + 1]));
+			squares.hi[(size_t)j * squares.size + i] = std::max(std::max(h[0], h[1]), std::max(h[n], h[n + 1]));
+		}
+	levels.push_back(squares);
+
+	while (levels.back().size > 1) {
+		const Level& below = levels.back();
+		Level up;
+		up.size = (below.size + 1) / 2;
+		up.lo.assign((size_t)up.size * up.size, HUGE_VALF);
+		up.hi.assign(up.lo.size(), -HUGE_VALF);
+		for (unsigned int j = 0; j < below.size; ++j)
+			for (unsigned int i = 0; i < below.size; ++i) {
+				size_t k = (size_t)(j / 2) * up.size + i / 2;
+				up.lo[k] = std::min(up.lo[k], below.lo[(size_t)j * below.size + i]);
+				up.hi[k] = std::max(up.hi[k], below.hi[(size_t)j * below.size + i]);
+			}
+		levels.push_back(up);
+	}
+}
+
+//****************************************************************************
+//
+// * the t the ray enters and leaves the box at, clipped to [0, tMax]
+//============================================================================
+static bool hitBox(const float* o, const float* d, const float* lo, const float* hi,
+	float tMax, float& enter, float& leave)
+//============================================================================
+{
+	enter = 0;
+	leave = tMax;
+	for (int a = 0; a < 3; ++a) {
+		if (d[a] == 0) {
+			if (o[a] < lo[a] || o[a] > hi[a])
+				return false;
+			continue;
+		}
+		float t0 = (lo[a] - o[a]) / d[a];
+		float t1 = (hi[a] - o[a]) / d[a];
+		if (t0 > t1)
+			std::swap(t0, t1);
+		enter = std::max(enter, t0);
+		leave = std::min(leave, t1);
+		if (enter > leave)
+			return false;
+	}
+	return true;
+}
+
+//****************************************************************************
+//
+// * Moller-Trumbore
+//============================================================================
+static bool hitTriangle(const float* o, const float* d, const float* a, const float* b,
+	const float* c, float tMax, float& t)
+//============================================================================
+{
+	float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+	float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+	float p[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+	float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+	if (fabsf(det) < 1e-12f)
+		return false;
+	float inv = 1.0f / det;
+	float s[3] = { o[0] - a[0], o[1] - a[1], o[2] - a[2] };
+	float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv;
+	if (u < 0 || u > 1)
+		return false;
+	float q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+	float v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inv;
+	if (v < 0 || u + v > 1)
+		return false;
+	float hit = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv;
+	if (hit < 0 || hit > tMax)
+		return false;
+	t = hit;
+	return true;
+}
+
+//****************************************************************************
+//
+// * the two triangles of square (i, j), split from (i + 1, j) to
+//   (i, j + 1) as WaterGrid splits them
+//============================================================================
+bool HeightField::
+hitSquare(unsigned int i, unsigned int j, const float* o, const float* d, float tMax, float& t) const
+//============================================================================
+{
+	const float x0 = i * cell - 1, x1 = x0 + cell;
+	const float z0 = j * cell - 1, z1 = z0 + cell;
+	const float* h = &height[(size_t)j * n + i];
+	const float a[3] = { x0, h[0], z0 };
+	const float b[3] = { x1, h[1], z0 };
+	const float c[3] = { x0, h[n], z1 };
+	const float e[3] = { x1, h[n + 1], z1 };
+
+	float t0, t1;
+	bool first = hitTriangle(o, d, b, a, c, tMax, t0);
+	bool second = hitTriangle(o, d, e, c, b, first ? t0 : tMax, t1);
+	if (second)
+		t = t1;
+	else if (first)
+		t = t0;
+	return first || second;
+}
+
+//****************************************************************************
+//
+// * the box of a node: the squares under it, from its lowest to its
+//   highest height
+//============================================================================
+void HeightField::
+nodeBox(int level, unsigned int i, unsigned int j, float* lo, float* hi) const
+//============================================================================
+{
+	const Level& l = levels[level];
+	const size_t k = (size_t)j * l.size + i;
+	const unsigned int span = 1u << level;
+	const unsigned int squares = n - 1;
+	lo[0] = i * span * cell - 1;
+	lo[1] = l.lo[k];
+	lo[2] = j * span * cell - 1;
+	hi[0] = std::min(i * span + span, squares) * cell - 1;
+	hi[1] = l.hi[k];
+	hi[2] = std::min(j * span + span, squares) * cell - 1;
+}
+
+//****************************************************************************
+//
+// * a node the ray is known to enter: its children whose boxes the ray
+//   passes through, nearest first, down to the squares
+//============================================================================
+bool HeightField::
+hitNode(int level, unsigned int i, unsigned int j, const float* o, const float* d,
+	float tMax, float& t) const
+//============================================================================
+{
+	if (level == 0)
+		return hitSquare(i, j, o, d, tMax, t);
+
+	struct Child { unsigned int i, j; float enter; } children[4];
+	int count = 0;
+	const unsigned int below = levels[level - 1].size;
+	for (unsigned int cj = 2 * j; cj < std::min(2 * j + 2, below); ++cj)
+		for (unsigned int ci = 2 * i; ci < std::min(2 * i + 2, below); ++ci) {
+			float lo[3], hi[3], enter, leave;
+			nodeBox(level - 1, ci, cj, lo, hi);
+			if (hitBox(o, d, lo, hi, tMax, enter, leave)) {
+				Child c = { ci, cj, enter };
+				children[count++] = c;
+			}
+		}
+	std::sort(children, children + count, [](const Child& a, const Child& b) { return a.enter < b.enter; });
+
+	// a child further on may still hold a nearer hit than one found,
+	// if their boxes overlap in t - so keep going while they could
+	bool found = false;
+	for (int c = 0; c < count; ++c) {
+		if (found && children[c].enter > t)
+			break;
+		float ct;
+		if (hitNode(level - 1, children[c].i, children[c].j, o, d, found ? t : tMax, ct)) {
+			t = ct;
+			found = true;
+		}
+	}
+	return found;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+bool HeightField::
+intersect(const float origin[3], const float dir[3], float tMax, float& t) const
+//============================================================================
+{
+	if (levels.empty())
+		return false;
+
+	const int top = (int)levels.size() - 1;
+	float lo[3], hi[3], enter, leave;
+	nodeBox(top, 0, 0, lo, hi);
+	return hitBox(origin, dir, lo, hi, tMax, enter, leave) && hitNode(top, 0, 0, origin, dir, tMax, t);
+}
@@ -0,0 +1,146 @@
+/************************************************************************
+     File:        JobPool.cpp
+
+     Comment:     A fixed set of worker threads that run jobs.
+						See JobPool.H
+
+*************************************************************************/
+
+#include "JobPool.H"
+
+//****************************************************************************
+//
+// * Constructor
+//============================================================================
+JobPool::
+JobPool(unsigned int threads)
+	: stopping(false)
+//============================================================================
+{
+	if (!threads)
+		threads = std::thread::hardware_concurrency();
+	for (unsigned int i = 1; i < threads; ++i)
+		workers.push_back(std::thread(&JobPool::work, this));
+}
+
+//****************************************************************************
+//
+// * whatever is still queued is dropped - the owners of the jobs wait
+//   for them before they go away
+//============================================================================
+JobPool::
+~JobPool()
+//============================================================================
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	jobAdded.notify_all();
+	for (std::thread& t : workers)
+		t.join();
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+JobPool& JobPool::
+shared()
+//============================================================================
+{
+	static JobPool pool;
+	return pool;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void JobPool::
+run(Group& group, Job job)
+//============================================================================
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		++group.pending;
+		Queued q = { std::move(job), &group };
+		queue.push_back(std::move(q));
+	}
+	jobAdded.notify_one();
+}
+
+//****************************************************************************
+//
+// * called and returns with the lock held
+//============================================================================
+void JobPool::
+execute(Queued& q, std::unique_lock<std::mutex>& lock)
+//============================================================================
+{
+	lock.unlock();
+	q.job();
+	lock.lock();
+	if (--q.group->pending == 0)
+		jobDone.notify_all();
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void JobPool::
+wait(Group& group)
+//============================================================================
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (group.pending) {
+		if (queue.empty()) {
+			// the rest of the group is running on the workers
+			jobDone.wait(lock);
+			continue;
+		}
+		Queued q = std::move(queue.front());
+		queue.pop_front();
+		execute(q, lock);
+	}
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void JobPool::
+parallelFor(unsigned int n, const std::function<void(unsigned int)>& job)
+//============================================================================
+{
+	if (n == 1 || workers.empty()) {
+		for (unsigned int i = 0; i < n; ++i)
+			job(i);
+		return;
+	}
+
+	Group group;
+	for (unsigned int i = 0; i < n; ++i)
+		run(group, [&job, i] { job(i); });
+	wait(group);
+}
+
+//****************************************************************************
+//
+// * a worker thread
+//============================================================================
+void JobPool::
+work()
+//============================================================================
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		jobAdded.wait(lock, [this] { return stopping || !queue.empty(); });
+		if (stopping)
+			return;
+		Queued q = std::move(queue.front());
+		queue.pop_front();
+		execute(q, lock);
+	}
+}
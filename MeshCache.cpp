@@ -0,0 +1,241 @@
+/************************************************************************
+     File:        MeshCache.cpp
+
+     Comment:     A binary copy of each .obj model. See MeshCache.H
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "MeshCache.H"
+#include "MeshOptimize.H"
+#include "ObjParser.H"
+
+//****************************************************************************
+//
+// * size and modification time of a file, false if it is not there
+//============================================================================
+static bool fileStamp(const char* path, long long& size, long long& time)
+//============================================================================
+{
+	struct stat st;
+	if (stat(path, &st) != 0)
+		return false;
+	size = (long long)st.st_size;
+	time = (long long)st.st_mtime;
+	return true;
+}
+
+//****************************************************************************
+//
+// * Constructor
+//============================================================================
+MappedMesh::
+MappedMesh()
+	: base(nullptr), size(0), mapping(nullptr), header(nullptr),
+	  verts(nullptr), inds(nullptr), rngs(nullptr)
+//============================================================================
+{
+}
+
+MappedMesh::
+~MappedMesh()
+{
+	close();
+}
+
+//****************************************************************************
+//
+// * map the whole file and check the blocks fit in it
+//============================================================================
+bool MappedMesh::
+open(const char* path)
+//============================================================================
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER bytes;
+	GetFileSizeEx(file, &bytes);
+	size = (size_t)bytes.QuadPart;
+	HANDLE map = size ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+	CloseHandle(file);
+	if (!map)
+		return false;
+	base = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+	if (!base) {
+		CloseHandle(map);
+		return false;
+	}
+	mapping = map;
+#else
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+	size = (size_t)st.st_size;
+	base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (base == MAP_FAILED) {
+		base = nullptr;
+		return false;
+	}
+#endif
+
+	const MeshHeader* h = (const MeshHeader*)base;
+	size_t need = sizeof(MeshHeader);
+	if (size >= need && h->magic == MESH_MAGIC && h->version == MESH_VERSION) {
+		size_t v = (size_t)h->vertexCount * MESH_VERTEX_FLOATS * sizeof(float);
+		size_t i = (size_t)h->indexCount * sizeof(unsigned int);
+		size_t r = (size_t)h->rangeCount * sizeof(MeshRange);
+		if (size >= need + v + i + r) {
+			const char* p = (const char*)base + need;
+			header = h;
+			verts = (const float*)p;
+			inds = (const unsigned int*)(p + v);
+			rngs = (const MeshRange*)(p + v + i);
+			return true;
+		}
+	}
+
+	printf("%s is not a mesh file\n", path);
+	close();
+	return false;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void MappedMesh::
+close()
+//============================================================================
+{
+#ifdef _WIN32
+	if (base)
+		UnmapViewOfFile(base);
+	if (mapping)
+		CloseHandle((HANDLE)mapping);
+#else
+	if (base)
+		munmap(base, size);
+#endif
+	base = nullptr;
+	mapping = nullptr;
+	size = 0;
+	header = nullptr;
+	verts = nullptr;
+	inds = nullptr;
+	rngs = nullptr;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+std::string
+meshCachePath(const char* objPath)
+//============================================================================
+{
+	std::string path(objPath);
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("/\\");
+	if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+		path.erase(dot);
+	return path + ".mesh";
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+bool
+writeMeshCache(const char* meshPath, const MeshData& mesh, const char* objPath)
+//============================================================================
+{
+	MeshHeader h;
+	memset(&h, 0, sizeof(h));
+	h.magic = MESH_MAGIC;
+	h.version = MESH_VERSION;
+	h.vertexCount = mesh.vertexCount();
+	h.indexCount = (unsigned int)mesh.indices.size();
+	h.rangeCount = (unsigned int)mesh.ranges.size();
+	if (objPath)
+		fileStamp(objPath, h.sourceSize, h.sourceTime);
+
+	// written under another name first, so a half written file is never
+	// taken for a good one
+	std::string tmp = std::string(meshPath) + ".tmp";
+	FILE* fp = fopen(tmp.c_str(), "wb");
+	if (!fp) {
+		printf("Can't write %s\n", tmp.c_str());
+		return false;
+	}
+	bool ok = fwrite(&h, sizeof(h), 1, fp) == 1;
+	if (ok && !mesh.vertices.empty())
+		ok = fwrite(mesh.vertices.data(), sizeof(float), mesh.vertices.size(), fp) == mesh.vertices.size();
+	if (ok && !mesh.indices.empty())
+		ok = fwrite(mesh.indices.data(), sizeof(unsigned int), mesh.indices.size(), fp) == mesh.indices.size();
+	if (ok && !mesh.ranges.empty())
+		ok = fwrite(mesh.ranges.data(), sizeof(MeshRange), mesh.ranges.size(), fp) == mesh.ranges.size();
+	ok = (fclose(fp) == 0) && ok;
+
+	remove(meshPath);
+	if (!ok || rename(tmp.c_str(), meshPath) != 0) {
+		remove(tmp.c_str());
+		printf("Can't write %s\n", meshPath);
+		return false;
+	}
+	return true;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+bool
+loadMeshCached(const char* objPath, MappedMesh& mesh)
+//============================================================================
+{
+	std::string meshPath = meshCachePath(objPath);
+
+	long long size = 0, time = 0;
+	bool haveObj = fileStamp(objPath, size, time);
+
+	if (mesh.open(meshPath.c_str())) {
+		// no .obj (shipped without it) is fine; a changed one is not
+		const MeshHeader& h = mesh.info();
+		if (!haveObj || (h.sourceSize == size && h.sourceTime == time))
+			return true;
+		mesh.close();
+	}
+
+	MeshData data;
+	if (!haveObj || !parseOBJ(objPath, data))
+		return false;
+	MeshStats stats;
+	optimizeMesh(data, &stats);
+	printf("%s: %u corners, %u -> %u vertices, ACMR %.2f -> %.2f\n", objPath, stats.corners,
+		stats.verticesBefore, stats.verticesAfter, stats.acmrBefore, stats.acmrAfter);
+	if (!writeMeshCache(meshPath.c_str(), data, objPath))
+		return false;
+	return mesh.open(meshPath.c_str());
+}
@@ -0,0 +1,271 @@
+/************************************************************************
+     File:        MeshOptimize.cpp
+
+     Comment:     Welds, reorders and renumbers a mesh for the GPU.
+						See MeshOptimize.H
+
+*************************************************************************/
+
+#include <string.h>
+
+#include <vector>
+
+#include "MeshOptimize.H"
+
+static const unsigned int NO_VERTEX = 0xffffffffu;
+
+//****************************************************************************
+//
+// * The vertices of a mesh, by their exact value. -0 and 0 are taken as
+//   the same number, so a normal written either way welds
+//============================================================================
+class VertexMap
+//============================================================================
+{
+public:
+	VertexMap(const float* vertices, size_t expected)
+		: data(vertices)
+	{
+		size_t n = 16;
+		while (n < expected * 2)
+			n *= 2;
+		mask = n - 1;
+		slots.assign(n, NO_VERTEX);
+	}
+
+	// the first vertex equal to v, which is v itself if there is none
+	unsigned int find(unsigned int v)
+	{
+		unsigned int key[MESH_VERTEX_FLOATS];
+		bits(v, key);
+		size_t h = 0;
+		for (int k = 0; k < MESH_VERTEX_FLOATS; ++k)
+			h = (h ^ key[k]) * 16777619u;
+		for (h &= mask;; h = (h + 1) & mask) {
+			if (slots[h] == NO_VERTEX) {
+				slots[h] = v;
+				return v;
+			}
+			unsigned int other[MESH_VERTEX_FLOATS];
+			bits(slots[h], other);
+			if (memcmp(key, other, sizeof(key)) == 0)
+				return slots[h];
+		}
+	}
+
+private:
+	void bits(unsigned int v, unsigned int* out) const
+	{
+		memcpy(out, &data[(size_t)v * MESH_VERTEX_FLOATS], MESH_VERTEX_FLOATS * sizeof(float));
+		for (int k = 0; k < MESH_VERTEX_FLOATS; ++k)
+			if (out[k] == 0x80000000u)
+				out[k] = 0;
+	}
+
+	const float*				data;
+	size_t						mask;
+	std::vector<unsigned int>	slots;
+};
+
+//****************************************************************************
+//
+// * make every index point at the first of the vertices equal to it
+//============================================================================
+static void weld(MeshData& mesh)
+//============================================================================
+{
+	const unsigned int n = mesh.vertexCount();
+	std::vector<unsigned int> same(n);
+	VertexMap map(mesh.vertices.data(), n);
+	for (unsigned int v = 0; v < n; ++v)
+		same[v] = map.find(v);
+	for (unsigned int& i : mesh.indices)
+		i = same[i];
+}
+
+//****************************************************************************
+//
+// * Tipsify: put triangles [first, end) of indices in cache order in out.
+//   Starting from a vertex, all its triangles are drawn; the next vertex
+//   is the one of those triangles that will still be in the cache when
+//   its own remaining triangles are drawn and has been there longest.
+//   With none, the most recently used vertex with triangles left is
+//   taken, then the next one in the input.
+//
+//   live and stamp are per vertex and shared between the ranges, as is
+//   time; live is back to 0 for every vertex when this returns
+//============================================================================
+static void tipsify(const unsigned int* indices, unsigned int first, unsigned int end,
+	const std::vector<unsigned int>& adjStart, const std::vector<unsigned int>& adjTris,
+	std::vector<int>& live, std::vector<unsigned int>& stamp, unsigned int& time,
+	unsigned int cacheSize, std::vector<char>& emitted, unsigned int* out)
+//============================================================================
+{
+	for (size_t i = (size_t)first * 3; i < (size_t)end * 3; ++i)
+		++live[indices[i]];
+
+	std::vector<unsigned int> deadEnd;
+	std::vector<unsigned int> candidates;
+	size_t cursor = (size_t)first * 3;
+	unsigned int f = indices[cursor];
+
+	for (;;) {
+		candidates.clear();
+		for (unsigned int a = adjStart[f]; a < adjStart[f + 1]; ++a) {
+			unsigned int t = adjTris[a];
+			if (t < first || t >= end || emitted[t])
+				continue;
+			emitted[t] = 1;
+			for (int c = 0; c < 3; ++c) {
+				unsigned int v = indices[(size_t)t * 3 + c];
+				*out++ = v;
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				--live[v];
+				if (time - stamp[v] > cacheSize)
+					stamp[v] = time++;
+			}
+		}
+
+		unsigned int next = NO_VERTEX;
+		int best = -1;
+		for (unsigned int v : candidates) {
+			if (live[v] <= 0)
+				continue;
+			int priority = 0;
+			if (time - stamp[v] + 2 * live[v] <= cacheSize)
+				priority = (int)(time - stamp[v]);
+			if (priority > best) {
+				best = priority;
+				next = v;
+			}
+		}
+		while (next == NO_VERTEX && !deadEnd.empty()) {
+			unsigned int v = deadEnd.back();
+			deadEnd.pop_back();
+			if (live[v] > 0)
+				next = v;
+		}
+		while (next == NO_VERTEX && cursor < (size_t)end * 3) {
+			unsigned int v = indices[cursor++];
+			if (live[v] > 0)
+				next = v;
+		}
+		if (next == NO_VERTEX)
+			return;
+		f = next;
+	}
+}
+
+//****************************************************************************
+//
+// * reorder the triangles of every range for the cache
+//============================================================================
+static void reorder(MeshData& mesh, unsigned int cacheSize)
+//============================================================================
+{
+	const unsigned int n = mesh.vertexCount();
+	const unsigned int triangles = (unsigned int)(mesh.indices.size() / 3);
+	const unsigned int* indices = mesh.indices.data();
+
+	// the triangles around each vertex
+	std::vector<unsigned int> adjStart(n + 1, 0);
+	for (size_t i = 0; i < (size_t)triangles * 3; ++i)
+		++adjStart[indices[i] + 1];
+	for (unsigned int v = 0; v < n; ++v)
+		adjStart[v + 1] += adjStart[v];
+	std::vector<unsigned int> adjTris(adjStart[n]);
+	std::vector<unsigned int> fill(adjStart.begin(), adjStart.end() - 1);
+	for (unsigned int t = 0; t < triangles; ++t)
+		for (int c = 0; c < 3; ++c)
+			adjTris[fill[indices[(size_t)t * 3 + c]]++] = t;
+
+	std::vector<int> live(n, 0);
+	std::vector<unsigned int> stamp(n, 0);
+	std::vector<char> emitted(triangles, 0);
+	unsigned int time = cacheSize + 1;
+
+	// indices outside every range stay where they were
+	std::vector<unsigned int> out(mesh.indices);
+	for (const MeshRange& r : mesh.ranges) {
+		if (r.count < 3)
+			continue;
+		tipsify(indices, r.first / 3, (r.first + r.count) / 3, adjStart, adjTris,
+			live, stamp, time, cacheSize, emitted, &out[r.first]);
+	}
+	mesh.indices.swap(out);
+}
+
+//****************************************************************************
+//
+// * renumber the vertices in the order the indices first use them,
+//   dropping the ones no index uses
+//============================================================================
+static void renumber(MeshData& mesh)
+//============================================================================
+{
+	const unsigned int n = mesh.vertexCount();
+	std::vector<unsigned int> remap(n, NO_VERTEX);
+	std::vector<float> vertices;
+	vertices.reserve(mesh.vertices.size());
+	unsigned int used = 0;
+	for (unsigned int& i : mesh.indices) {
+		if (remap[i] == NO_VERTEX) {
+			remap[i] = used++;
+			const float* v = &mesh.vertices[(size_t)i * MESH_VERTEX_FLOATS];
+			vertices.insert(vertices.end(), v, v + MESH_VERTEX_FLOATS);
+		}
+		i = remap[i];
+	}
+	mesh.vertices.swap(vertices);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+float
+meshACMR(const unsigned int* indices, size_t count, unsigned int vertexCount, unsigned int cacheSize)
+//============================================================================
+{
+	if (count < 3)
+		return 0;
+
+	// a vertex is in the FIFO if it went in less than cacheSize misses ago
+	std::vector<unsigned int> in(vertexCount, 0);
+	unsigned int misses = 0;
+	for (size_t i = 0; i < count; ++i) {
+		unsigned int v = indices[i];
+		if (in[v] == 0 || misses - in[v] >= cacheSize) {
+			++misses;
+			in[v] = misses;
+		}
+	}
+	return (float)misses / (float)(count / 3);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void
+optimizeMesh(MeshData& mesh, MeshStats* stats, unsigned int cacheSize)
+//============================================================================
+{
+	if (stats) {
+		stats->corners = (unsigned int)mesh.indices.size();
+		stats->verticesBefore = mesh.vertexCount();
+		stats->acmrBefore = meshACMR(mesh.indices.data(), mesh.indices.size(), mesh.vertexCount(), cacheSize);
+	}
+
+	if (!mesh.indices.empty()) {
+		weld(mesh);
+		reorder(mesh, cacheSize);
+		renumber(mesh);
+	}
+
+	if (stats) {
+		stats->verticesAfter = mesh.vertexCount();
+		stats->acmrAfter = meshACMR(mesh.indices.data(), mesh.indices.size(), mesh.vertexCount(), cacheSize);
+	}
+}
@@ -0,0 +1,287 @@
+/************************************************************************
+     File:        ModelArena.cpp
+
+     Comment:     Many part models in one draw call. See ModelArena.H
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ModelArena.H"
+#include "MeshCache.H"
+#include "RenderUtilities/Shader.h"
+
+//****************************************************************************
+//
+// * Constructor
+//============================================================================
+ModelArena::
+ModelArena()
+	: maxCharacters(0), vao(0), vbo(0), ebo(0), indirect(0), perDraw(0),
+	  transformBuffer(0), materialBuffer(0), drawCapacity(0)
+//============================================================================
+{
+}
+
+//****************************************************************************
+//
+// * the number of a material, added in grey if it is new
+//============================================================================
+unsigned int ModelArena::
+material(const std::string& name)
+//============================================================================
+{
+	for (size_t i = 0; i < materialNames.size(); ++i)
+		if (materialNames[i] == name)
+			return (unsigned int)i;
+	materialNames.push_back(name);
+	const float grey[4] = { 0.6f, 0.6f, 0.6f, 1.0f };
+	materialColors.insert(materialColors.end(), grey, grey + 4);
+	return (unsigned int)materialNames.size() - 1;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+bool ModelArena::
+loadMaterials(const char* mtlPath)
+//============================================================================
+{
+	FILE* fp = fopen(mtlPath, "r");
+	if (!fp) {
+		printf("Can't read %s\n", mtlPath);
+		return false;
+	}
+
+	char line[256], name[128];
+	int current = -1;
+	while (fgets(line, sizeof(line), fp)) {
+		float r, g, b;
+		if (sscanf(line, " newmtl %127s", name) == 1)
+			current = (int)material(name);
+		else if (current >= 0 && sscanf(line, " Kd %f %f %f", &r, &g, &b) == 3) {
+			float* c = &materialColors[(size_t)current * 4];
+			c[0] = r;
+			c[1] = g;
+			c[2] = b;
+		}
+	}
+	fclose(fp);
+
+	if (materialBuffer) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, materialBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, materialColors.size() * sizeof(float),
+			materialColors.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+	return true;
+}
+
+//****************************************************************************
+//
+// * append the vertices and indices of a part to the arena; its indices
+//   stay relative to its own first vertex, which the commands pass as
+//   the base vertex
+//============================================================================
+int ModelArena::
+addPart(const char* objPath)
+//============================================================================
+{
+	if (vao)
+		return -1;
+
+	MappedMesh mesh;
+	if (!loadMeshCached(objPath, mesh))
+		return -1;
+
+	Part part;
+	part.firstRange = (unsigned int)ranges.size();
+	part.baseVertex = (int)(vertices.size() / MESH_VERTEX_FLOATS);
+
+	const unsigned int firstIndex = (unsigned int)indices.size();
+	vertices.insert(vertices.end(), mesh.vertices(),
+		mesh.vertices() + (size_t)mesh.vertexCount() * MESH_VERTEX_FLOATS);
+	indices.insert(indices.end(), mesh.indices(), mesh.indices() + mesh.indexCount());
+
+	for (unsigned int r = 0; r < mesh.rangeCount(); ++r) {
+		const MeshRange& m = mesh.ranges()[r];
+		if (!m.count)
+			continue;
+		Range range;
+		range.firstIndex = firstIndex + m.first;
+		range.count = m.count;
+		range.material = material(m.material);
+		ranges.push_back(range);
+	}
+	part.rangeCount = (unsigned int)ranges.size() - part.firstRange;
+	partList.push_back(part);
+
+	return (int)partList.size() - 1;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void ModelArena::
+setCapacity(unsigned int characters)
+//============================================================================
+{
+	maxCharacters = characters;
+	transforms.resize((size_t)maxCharacters * partList.size() * 16);
+	for (size_t i = 0; i < transforms.size(); ++i)
+		transforms[i] = (i % 16) % 5 == 0 ? 1.0f : 0.0f;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void ModelArena::
+setTransform(unsigned int character, unsigned int part, const float* m)
+//============================================================================
+{
+	if (character >= maxCharacters || part >= partList.size())
+		return;
+	memcpy(&transforms[((size_t)character * partList.size() + part) * 16], m, 16 * sizeof(float));
+}
+
+//****************************************************************************
+//
+// * upload the arena and make the per frame buffers
+//============================================================================
+void ModelArena::
+create()
+//============================================================================
+{
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(1, &vbo);
+	glGenBuffers(1, &ebo);
+	glGenBuffers(1, &indirect);
+	glGenBuffers(1, &perDraw);
+	glGenBuffers(1, &transformBuffer);
+	glGenBuffers(1, &materialBuffer);
+
+	glBindVertexArray(vao);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+	const GLsizei stride = MESH_VERTEX_FLOATS * sizeof(float);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(5 * sizeof(float)));
+	glEnableVertexAttribArray(2);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+	// one record per command; its base instance is its own number, so
+	// instance 0 of command i reads record i
+	glBindBuffer(GL_ARRAY_BUFFER, perDraw);
+	glVertexAttribIPointer(3, 2, GL_UNSIGNED_INT, 2 * sizeof(GLuint), (GLvoid*)0);
+	glEnableVertexAttribArray(3);
+	glVertexAttribDivisor(3, 1);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, materialBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, materialColors.size() * sizeof(float),
+		materialColors.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+//****************************************************************************
+//
+// * write the commands and transforms of n characters and draw them all
+//============================================================================
+void ModelArena::
+draw(unsigned int n, Shader* shader, bool doingShadows)
+//============================================================================
+{
+	if (n > maxCharacters)
+		n = maxCharacters;
+	if (!n || !shader || partList.empty() || materialColors.empty())
+		return;
+
+	if (!vao)
+		create();
+
+	commands.clear();
+	drawInfo.clear();
+	const unsigned int partCount = (unsigned int)partList.size();
+	for (unsigned int c = 0; c < n; ++c)
+		for (unsigned int p = 0; p < partCount; ++p) {
+			const Part& part = partList[p];
+			for (unsigned int r = part.firstRange; r < part.firstRange + part.rangeCount; ++r) {
+				DrawCommand cmd;
+				cmd.count = ranges[r].count;
+				cmd.instanceCount = 1;
+				cmd.firstIndex = ranges[r].firstIndex;
+				cmd.baseVertex = part.baseVertex;
+				cmd.baseInstance = (GLuint)commands.size();
+				commands.push_back(cmd);
+				drawInfo.push_back(c * partCount + p);
+				drawInfo.push_back(ranges[r].material);
+			}
+		}
+
+	// orphaned every frame, so the driver need not wait for the last one
+	const unsigned int drawCount = (unsigned int)commands.size();
+	if (drawCount > drawCapacity)
+		drawCapacity = drawCount;
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, drawCapacity * sizeof(DrawCommand), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, drawCount * sizeof(DrawCommand), commands.data());
+
+	glBindBuffer(GL_ARRAY_BUFFER, perDraw);
+	glBufferData(GL_ARRAY_BUFFER, drawCapacity * 2 * sizeof(GLuint), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, drawInfo.size() * sizeof(GLuint), drawInfo.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	const GLsizeiptr transformBytes = (GLsizeiptr)n * partCount * 16 * sizeof(float);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, transformBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, transformBytes, transforms.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, transformBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, materialBuffer);
+
+	GLfloat view_matrix[16];
+	GLfloat projection_matrix[16];
+	glGetFloatv(GL_MODELVIEW_MATRIX, view_matrix);
+	glGetFloatv(GL_PROJECTION_MATRIX, projection_matrix);
+
+	shader->Use();
+	shader->setMat4("u_view", view_matrix);
+	shader->setMat4("u_projection", projection_matrix);
+	shader->setInt("u_shadow", doingShadows);
+
+	glBindVertexArray(vao);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (GLvoid*)0, drawCount, 0);
+	glBindVertexArray(0);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glUseProgram(0);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void ModelArena::
+release()
+//============================================================================
+{
+	if (vao)
+		glDeleteVertexArrays(1, &vao);
+	GLuint buffers[] = { vbo, ebo, indirect, perDraw, transformBuffer, materialBuffer };
+	for (GLuint b : buffers)
+		if (b)
+			glDeleteBuffers(1, &b);
+	vao = vbo = ebo = indirect = perDraw = transformBuffer = materialBuffer = 0;
+	drawCapacity = 0;
+}
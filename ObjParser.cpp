@@ -0,0 +1,533 @@
+/************************************************************************
+     File:        ObjParser.cpp
+
+     Comment:     A fast .obj reader. See ObjParser.H
+
+*************************************************************************/
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include "ObjParser.H"
+#include "JobPool.H"
+
+// pieces below this size are not worth a job of their own
+static const size_t MIN_PIECE = 256 * 1024;
+
+static const int MISSING = INT_MAX;
+
+static const unsigned int NO_VERTEX = 0xffffffffu;
+
+// one corner of a face: indices of position, uv and normal, from 0.
+// A relative index (negative in the file) is kept relative to the start
+// of its piece until the pieces before it have been counted
+struct Corner
+{
+	int				v, vt, vn;
+	unsigned char	relative;		// RELATIVE_V | RELATIVE_VT | RELATIVE_VN
+};
+
+enum { RELATIVE_V = 1, RELATIVE_VT = 2, RELATIVE_VN = 4 };
+
+struct UseMaterial
+{
+	unsigned int	face;			// the faces of the piece before it
+	std::string		name;
+};
+
+// what one piece of the file holds
+struct Piece
+{
+	const char*					begin;
+	const char*					end;
+	std::vector<float>			v, vt, vn;		// 3, 2 and 3 floats each
+	std::vector<Corner>			corners;
+	std::vector<unsigned int>	faceSizes;
+	std::vector<UseMaterial>	materials;
+	int							badLine;		// line number in the piece, 0 if none
+};
+
+static inline bool isBlank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool isDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static inline const char* skipBlanks(const char* p, const char* end)
+{
+	while (p < end && isBlank(*p))
+		++p;
+	return p;
+}
+
+//****************************************************************************
+//
+// * a decimal number, like strtof but without the locale. Null if there
+//   is no number at p
+//============================================================================
+static const char* parseFloat(const char* p, const char* end, float& out)
+//============================================================================
+{
+	static const double POWERS[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	p = skipBlanks(p, end);
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = (*p++ == '-');
+
+	double mantissa = 0;
+	int exponent = 0;
+	bool digits = false;
+	while (p < end && isDigit(*p)) {
+		mantissa = mantissa * 10 + (*p++ - '0');
+		digits = true;
+	}
+	if (p < end && *p == '.') {
+		++p;
+		while (p < end && isDigit(*p)) {
+			mantissa = mantissa * 10 + (*p++ - '0');
+			--exponent;
+			digits = true;
+		}
+	}
+	if (!digits)
+		return nullptr;
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		const char* q = p + 1;
+		bool negExp = false;
+		if (q < end && (*q == '-' || *q == '+'))
+			negExp = (*q++ == '-');
+		if (q < end && isDigit(*q)) {
+			int e = 0;
+			while (q < end && isDigit(*q))
+				e = (e < 10000) ? e * 10 + (*q++ - '0') : (++q, e);
+			exponent += negExp ? -e : e;
+			p = q;
+		}
+	}
+
+	double value;
+	if (exponent == 0)
+		value = mantissa;
+	else if (exponent > 0 && exponent <= 22)
+		value = mantissa * POWERS[exponent];
+	else if (exponent < 0 && exponent >= -22)
+		value = mantissa / POWERS[-exponent];
+	else
+		value = mantissa * pow(10.0, exponent);
+
+	out = (float)(negative ? -value : value);
+	return p;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+static const char* parseInt(const char* p, const char* end, int& out)
+//============================================================================
+{
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = (*p++ == '-');
+	if (p >= end || !isDigit(*p))
+		return nullptr;
+	long long n = 0;
+	while (p < end && isDigit(*p)) {
+		if (n < INT_MAX)
+			n = n * 10 + (*p - '0');
+		++p;
+	}
+	if (n > INT_MAX)
+		n = INT_MAX;
+	out = (int)(negative ? -n : n);
+	return p;
+}
+
+//****************************************************************************
+//
+// * index k of the file (from 1, or negative from the end so far) into
+//   a 0 based one, relative to the start of the piece if it was negative
+//============================================================================
+static inline bool fileIndex(int k, size_t countSoFar, int& index, unsigned char& relative, unsigned char flag)
+//============================================================================
+{
+	if (k > 0) {
+		index = k - 1;
+		return true;
+	}
+	if (k < 0) {
+		index = (int)countSoFar + k;
+		relative |= flag;
+		return true;
+	}
+	return false;		// 0 is not an index
+}
+
+//****************************************************************************
+//
+// * one line, from after the blanks at its start to before its end
+//============================================================================
+static bool parseLine(Piece& piece, const char* p, const char* end)
+//============================================================================
+{
+	if (p >= end || *p == '#')
+		return true;
+
+	size_t word = 0;
+	while (p + word < end && !isBlank(p[word]))
+		++word;
+
+	if (word == 1 && *p == 'v') {
+		float xyz[3];
+		const char* q = p + 1;
+		for (int i = 0; i < 3; ++i)
+			if (!(q = parseFloat(q, end, xyz[i])))
+				return false;
+		piece.v.insert(piece.v.end(), xyz, xyz + 3);
+	}
+	else if (word == 2 && p[0] == 'v' && p[1] == 't') {
+		float uv[2] = { 0, 0 };
+		const char* q = parseFloat(p + 2, end, uv[0]);
+		if (!q)
+			return false;
+		parseFloat(q, end, uv[1]);		// v is optional
+		piece.vt.insert(piece.vt.end(), uv, uv + 2);
+	}
+	else if (word == 2 && p[0] == 'v' && p[1] == 'n') {
+		float n[3];
+		const char* q = p + 2;
+		for (int i = 0; i < 3; ++i)
+			if (!(q = parseFloat(q, end, n[i])))
+				return false;
+		piece.vn.insert(piece.vn.end(), n, n + 3);
+	}
+	else if (word == 1 && *p == 'f') {
+		const size_t nv = piece.v.size() / 3, nvt = piece.vt.size() / 2, nvn = piece.vn.size() / 3;
+		unsigned int size = 0;
+		const char* q = skipBlanks(p + 1, end);
+		while (q < end) {
+			Corner c = { MISSING, MISSING, MISSING, 0 };
+			int k;
+			if (!(q = parseInt(q, end, k)) || !fileIndex(k, nv, c.v, c.relative, RELATIVE_V))
+				return false;
+			if (q < end && *q == '/') {
+				++q;
+				if (q < end && *q != '/') {
+					if (!(q = parseInt(q, end, k)) || !fileIndex(k, nvt, c.vt, c.relative, RELATIVE_VT))
+						return false;
+				}
+				if (q < end && *q == '/') {
+					++q;
+					if (!(q = parseInt(q, end, k)) || !fileIndex(k, nvn, c.vn, c.relative, RELATIVE_VN))
+						return false;
+				}
+			}
+			if (q < end && !isBlank(*q))
+				return false;
+			piece.corners.push_back(c);
+			++size;
+			q = skipBlanks(q, end);
+		}
+		if (size < 3)
+			return false;
+		piece.faceSizes.push_back(size);
+	}
+	else if (word == 6 && !strncmp(p, "usemtl", 6)) {
+		const char* name = skipBlanks(p + 6, end);
+		const char* last = end;
+		while (last > name && isBlank(last[-1]))
+			--last;
+		UseMaterial use = { (unsigned int)piece.faceSizes.size(), std::string(name, last) };
+		piece.materials.push_back(use);
+	}
+	// anything else (o, g, s, mtllib, ...) is not needed to draw
+
+	return true;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+static void parsePiece(Piece& piece)
+//============================================================================
+{
+	piece.badLine = 0;
+	int line = 0;
+	for (const char* p = piece.begin; p < piece.end; ) {
+		const char* eol = (const char*)memchr(p, '\n', piece.end - p);
+		if (!eol)
+			eol = piece.end;
+		++line;
+		if (!parseLine(piece, skipBlanks(p, eol), eol) && !piece.badLine)
+			piece.badLine = line;
+		p = eol + 1;
+	}
+}
+
+//****************************************************************************
+//
+// * open addressing map from a (v, vt, vn) corner to its vertex
+//============================================================================
+class CornerMap
+//============================================================================
+{
+public:
+	explicit CornerMap(size_t expected)
+	{
+		size_t n = 16;
+		while (n < expected * 2)
+			n *= 2;
+		mask = n - 1;
+		keys.resize(n);
+		values.assign(n, NO_VERTEX);
+	}
+
+	// the vertex of c, adding it as vertex next if it is new
+	unsigned int find(const Corner& c, unsigned int next, bool& added)
+	{
+		size_t h = ((size_t)(unsigned int)c.v * 73856093u ^ (size_t)(unsigned int)c.vt * 19349663u
+			^ (size_t)(unsigned int)c.vn * 83492791u) & mask;
+		for (;; h = (h + 1) & mask) {
+			if (values[h] == NO_VERTEX) {
+				keys[h] = c;
+				values[h] = next;
+				added = true;
+				return next;
+			}
+			const Corner& k = keys[h];
+			if (k.v == c.v && k.vt == c.vt && k.vn == c.vn) {
+				added = false;
+				return values[h];
+			}
+		}
+	}
+
+private:
+	size_t						mask;
+	std::vector<Corner>			keys;
+	std::vector<unsigned int>	values;
+};
+
+//****************************************************************************
+//
+// *
+//============================================================================
+bool
+parseOBJText(const char* text, size_t length, MeshData& mesh, JobPool* jobs)
+//============================================================================
+{
+	if (!jobs)
+		jobs = &JobPool::shared();
+
+	// cut at line ends into about four pieces a thread
+	size_t nPieces = length / MIN_PIECE + 1;
+	if (nPieces > jobs->size() * 4)
+		nPieces = jobs->size() * 4;
+	std::vector<Piece> pieces(nPieces);
+	const char* end = text + length;
+	const char* p = text;
+	for (size_t i = 0; i < nPieces; ++i) {
+		const char* cut = (i + 1 == nPieces) ? end : text + length / nPieces * (i + 1);
+		if (cut < p)
+			cut = p;
+		while (cut > text && cut < end && cut[-1] != '\n')
+			++cut;
+		pieces[i].begin = p;
+		pieces[i].end = cut;
+		p = cut;
+	}
+
+	jobs->parallelFor((unsigned int)nPieces, [&pieces](unsigned int i) {
+		parsePiece(pieces[i]);
+	});
+
+	// everything in file order, with the indices made absolute
+	size_t nv = 0, nvt = 0, nvn = 0, nCorners = 0, nFaces = 0;
+	for (size_t i = 0; i < nPieces; ++i) {
+		Piece& piece = pieces[i];
+		if (piece.badLine) {
+			int line = 1;
+			for (const char* q = text; q < piece.begin; ++q)
+				line += (*q == '\n');
+			printf("obj: can't read line %d\n", line + piece.badLine - 1);
+			return false;
+		}
+		for (Corner& c : piece.corners) {
+			if (c.relative & RELATIVE_V)	c.v += (int)nv;
+			if (c.relative & RELATIVE_VT)	c.vt += (int)nvt;
+			if (c.relative & RELATIVE_VN)	c.vn += (int)nvn;
+		}
+		nv += piece.v.size() / 3;
+		nvt += piece.vt.size() / 2;
+		nvn += piece.vn.size() / 3;
+		nCorners += piece.corners.size();
+		nFaces += piece.faceSizes.size();
+	}
+
+	std::vector<float> positions, uvs, normals;
+	positions.reserve(nv * 3);
+	uvs.reserve(nvt * 2);
+	normals.reserve(nvn * 3);
+	for (const Piece& piece : pieces) {
+		positions.insert(positions.end(), piece.v.begin(), piece.v.end());
+		uvs.insert(uvs.end(), piece.vt.begin(), piece.vt.end());
+		normals.insert(normals.end(), piece.vn.begin(), piece.vn.end());
+	}
+
+	bool needSmooth = false;
+	for (const Piece& piece : pieces)
+		for (const Corner& c : piece.corners) {
+			if (c.v < 0 || (size_t)c.v >= nv
+				|| (c.vt != MISSING && (c.vt < 0 || (size_t)c.vt >= nvt))
+				|| (c.vn != MISSING && (c.vn < 0 || (size_t)c.vn >= nvn))) {
+				printf("obj: index out of range\n");
+				return false;
+			}
+			needSmooth = needSmooth || c.vn == MISSING;
+		}
+
+	// corners without a normal share the normal of their position: the
+	// sum of the (area weighted, Newell) normals of the faces around it
+	std::vector<float> smooth;
+	if (needSmooth) {
+		smooth.assign(nv * 3, 0.0f);
+		for (const Piece& piece : pieces) {
+			const Corner* c = piece.corners.data();
+			for (unsigned int size : piece.faceSizes) {
+				float n[3] = { 0, 0, 0 };
+				for (unsigned int k = 0; k < size; ++k) {
+					const float* a = &positions[(size_t)c[k].v * 3];
+					const float* b = &positions[(size_t)c[(k + 1) % size].v * 3];
+					n[0] += (a[1] - b[1]) * (a[2] + b[2]);
+					n[1] += (a[2] - b[2]) * (a[0] + b[0]);
+					n[2] += (a[0] - b[0]) * (a[1] + b[1]);
+				}
+				for (unsigned int k = 0; k < size; ++k)
+					if (c[k].vn == MISSING)
+						for (int j = 0; j < 3; ++j)
+							smooth[(size_t)c[k].v * 3 + j] += n[j];
+				c += size;
+			}
+		}
+		for (size_t i = 0; i < nv; ++i) {
+			float* n = &smooth[i * 3];
+			float len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			if (len > 0)
+				for (int j = 0; j < 3; ++j)
+					n[j] /= len;
+		}
+	}
+
+	// one vertex per distinct corner, the faces as fans of triangles, and
+	// a range each time the material changes
+	mesh.vertices.clear();
+	mesh.indices.clear();
+	mesh.ranges.clear();
+	mesh.vertices.reserve(nCorners * MESH_VERTEX_FLOATS);
+	mesh.indices.reserve((nCorners - 2 * nFaces) * 3);
+
+	CornerMap map(nCorners);
+	std::vector<unsigned int> face;
+	MeshRange range;
+	memset(&range, 0, sizeof(range));
+	auto useMaterial = [&mesh, &range](const std::string& name) {
+		range.count = (unsigned int)mesh.indices.size() - range.first;
+		if (range.count)
+			mesh.ranges.push_back(range);
+		memset(range.material, 0, sizeof(range.material));
+		strncpy(range.material, name.c_str(), sizeof(range.material) - 1);
+		range.first = (unsigned int)mesh.indices.size();
+	};
+
+	for (const Piece& piece : pieces) {
+		const Corner* c = piece.corners.data();
+		size_t use = 0;
+		for (size_t f = 0; f < piece.faceSizes.size(); ++f) {
+			for (; use < piece.materials.size() && piece.materials[use].face == f; ++use)
+				useMaterial(piece.materials[use].name);
+
+			const unsigned int size = piece.faceSizes[f];
+			face.resize(size);
+			for (unsigned int k = 0; k < size; ++k) {
+				bool added;
+				face[k] = map.find(c[k], mesh.vertexCount(), added);
+				if (!added)
+					continue;
+				const float* pos = &positions[(size_t)c[k].v * 3];
+				const float* n = (c[k].vn == MISSING) ? &smooth[(size_t)c[k].v * 3] : &normals[(size_t)c[k].vn * 3];
+				float uv[2] = { 0, 0 };
+				if (c[k].vt != MISSING) {
+					uv[0] = uvs[(size_t)c[k].vt * 2];
+					uv[1] = uvs[(size_t)c[k].vt * 2 + 1];
+				}
+				float vertex[MESH_VERTEX_FLOATS] = { pos[0], pos[1], pos[2], uv[0], uv[1], n[0], n[1], n[2] };
+				mesh.vertices.insert(mesh.vertices.end(), vertex, vertex + MESH_VERTEX_FLOATS);
+			}
+			for (unsigned int k = 1; k + 1 < size; ++k) {
+				mesh.indices.push_back(face[0]);
+				mesh.indices.push_back(face[k]);
+				mesh.indices.push_back(face[k + 1]);
+			}
+			c += size;
+		}
+		// a usemtl after the last face of the piece
+		for (; use < piece.materials.size(); ++use)
+			useMaterial(piece.materials[use].name);
+	}
+	range.count = (unsigned int)mesh.indices.size() - range.first;
+	if (range.count)
+		mesh.ranges.push_back(range);
+
+	return true;
+}
+
+//****************************************************************************
+//
+// * the whole file in one read
+//============================================================================
+bool
+parseOBJ(const char* path, MeshData& mesh, JobPool* jobs)
+//============================================================================
+{
+	FILE* fp = fopen(path, "rb");
+	if (!fp) {
+		printf("Impossible to open the .obj file %s\n", path);
+		return false;
+	}
+	// ftell makes up a length for what is not a plain file (a directory
+	// opens fine on Linux), too big to allocate
+	struct stat st;
+	if (stat(path, &st) != 0 || (st.st_mode & S_IFMT) != S_IFREG) {
+		fclose(fp);
+		printf("Can't read %s\n", path);
+		return false;
+	}
+	fseek(fp, 0, SEEK_END);
+	long length = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	std::vector<char> text(length > 0 ? (size_t)length : 1);
+	size_t got = length > 0 ? fread(text.data(), 1, (size_t)length, fp) : 0;
+	fclose(fp);
+	if (length < 0 || got != (size_t)length) {
+		printf("Can't read %s\n", path);
+		return false;
+	}
+
+	return parseOBJText(text.data(), got, mesh, jobs);
+}
@@ -0,0 +1,244 @@
+/************************************************************************
+     File:        ParticleRenderer.cpp
+
+     Comment:     Draws the fireworks as camera facing billboards.
+						See ParticleRenderer.H
+
+*************************************************************************/
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "ParticleRenderer.H"
+#include "ParticleSystem.H"
+#include "RenderUtilities/Shader.h"
+
+//****************************************************************************
+//
+// * Constructor
+//============================================================================
+ParticleRenderer::
+ParticleRenderer()
+	: vao(0), quad(0), instances(0), texture(0), capacity(0),
+	  persistent(false), mapped(nullptr), region(0)
+//============================================================================
+{
+	for (int i = 0; i < REGIONS; ++i)
+		fences[i] = 0;
+}
+
+//****************************************************************************
+//
+// * the quad, the instance buffer (big enough for every particle the
+//   system can hold) and the texture
+//============================================================================
+void ParticleRenderer::
+create(unsigned int n)
+//============================================================================
+{
+	static const GLfloat corners[] = {
+		-0.5f, -0.5f, 0.0f,
+		 0.5f, -0.5f, 0.0f,
+		-0.5f,  0.5f, 0.0f,
+		 0.5f,  0.5f, 0.0f,
+	};
+
+	capacity = n;
+	GLsizeiptr bytes = (GLsizeiptr)capacity * FLOATS_PER_PARTICLE * sizeof(float);
+
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(1, &quad);
+	glGenBuffers(1, &instances);
+
+	glBindVertexArray(vao);
+
+	glBindBuffer(GL_ARRAY_BUFFER, quad);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (GLvoid*)0);
+	glEnableVertexAttribArray(0);
+
+	glBindBuffer(GL_ARRAY_BUFFER, instances);
+	persistent = GLAD_GL_VERSION_4_4 != 0;
+	if (persistent) {
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, bytes * REGIONS, NULL, flags);
+		mapped = (float*)glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes * REGIONS, flags);
+		persistent = mapped != nullptr;
+	}
+	if (!persistent)
+		glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+
+	// xyzs on 1 and color on 2 - the offsets are set per frame in draw()
+	glEnableVertexAttribArray(1);
+	glVertexAttribDivisor(1, 1);
+	glEnableVertexAttribArray(2);
+	glVertexAttribDivisor(2, 1);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// a white spot that fades out towards the edge
+	const int SIZE = 32;
+	GLubyte spot[SIZE * SIZE * 4];
+	for (int j = 0; j < SIZE; ++j)
+		for (int i = 0; i < SIZE; ++i) {
+			float dx = (i + 0.5f) / SIZE * 2 - 1, dy = (j + 0.5f) / SIZE * 2 - 1;
+			float a = std::max(0.0f, 1.0f - sqrtf(dx * dx + dy * dy));
+			GLubyte* p = spot + (j * SIZE + i) * 4;
+			p[0] = p[1] = p[2] = 255;
+			p[3] = (GLubyte)(a * a * 255);
+		}
+
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, SIZE, SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, spot);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+//****************************************************************************
+//
+// * one instanced draw for all the particles
+//============================================================================
+void ParticleRenderer::
+draw(const ParticleSystem& particles, Shader* shader)
+//============================================================================
+{
+	unsigned int n = particles.size();
+	if (!n || !shader)
+		return;
+
+	if (!vao)
+		create(particles.capacity());
+	n = std::min(n, capacity);
+
+	const GLsizeiptr regionBytes = (GLsizeiptr)capacity * FLOATS_PER_PARTICLE * sizeof(float);
+	GLintptr offset = 0;
+	float* dst;
+
+	glBindBuffer(GL_ARRAY_BUFFER, instances);
+	if (persistent) {
+		// wait for the GPU to finish with the region used REGIONS frames ago
+		region = (region + 1) % REGIONS;
+		if (fences[region]) {
+			glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			glDeleteSync(fences[region]);
+			fences[region] = 0;
+		}
+		offset = region * regionBytes;
+		dst = mapped + (size_t)region * capacity * FLOATS_PER_PARTICLE;
+	}
+	else {
+		// orphan the old storage so the driver need not wait for it
+		glBufferData(GL_ARRAY_BUFFER, regionBytes, NULL, GL_STREAM_DRAW);
+		dst = (float*)glMapBufferRange(GL_ARRAY_BUFFER, 0, n * FLOATS_PER_PARTICLE * sizeof(float),
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (!dst) {
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			return;
+		}
+	}
+
+	const float* x = particles.xs();
+	const float* y = particles.ys();
+	const float* z = particles.zs();
+	const float* s = particles.sizes();
+	const float* r = particles.rs();
+	const float* g = particles.gs();
+	const float* b = particles.bs();
+	const float* a = particles.lifes();
+	for (unsigned int i = 0; i < n; ++i) {
+		float* p = dst + i * FLOATS_PER_PARTICLE;
+		p[0] = x[i];	p[1] = y[i];	p[2] = z[i];	p[3] = 2 * s[i];	// the quad is 1 wide
+		p[4] = r[i];	p[5] = g[i];	p[6] = b[i];	p[7] = a[i];
+	}
+
+	if (!persistent)
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+
+	glBindVertexArray(vao);
+	const GLsizei stride = FLOATS_PER_PARTICLE * sizeof(float);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offset);
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(offset + 4 * sizeof(float)));
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// the billboards face the camera: its right and up are the first two
+	// rows of the rotation part of the modelview matrix
+	GLfloat mv[16], proj[16], vp[16];
+	glGetFloatv(GL_MODELVIEW_MATRIX, mv);
+	glGetFloatv(GL_PROJECTION_MATRIX, proj);
+	for (int c = 0; c < 4; ++c)
+		for (int row = 0; row < 4; ++row) {
+			vp[c * 4 + row] = 0;
+			for (int k = 0; k < 4; ++k)
+				vp[c * 4 + row] += proj[k * 4 + row] * mv[c * 4 + k];
+		}
+
+	shader->Use();
+	const GLfloat right[3] = { mv[0], mv[4], mv[8] };
+	const GLfloat up[3] = { mv[1], mv[5], mv[9] };
+	shader->setMat4("VP", vp);
+	shader->setVec3("CameraRight_worldspace", right);
+	shader->setVec3("CameraUp_worldspace", up);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	shader->setInt("myTextureSampler", 0);
+
+	// glowing sparks: add up, and don't hide each other
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+	glDepthMask(GL_FALSE);
+
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, n);
+
+	glDepthMask(GL_TRUE);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDisable(GL_BLEND);
+
+	if (persistent)
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram(0);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void ParticleRenderer::
+release()
+//============================================================================
+{
+	for (int i = 0; i < REGIONS; ++i)
+		if (fences[i]) {
+			glDeleteSync(fences[i]);
+			fences[i] = 0;
+		}
+
+	if (instances) {
+		if (persistent) {
+			glBindBuffer(GL_ARRAY_BUFFER, instances);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		glDeleteBuffers(1, &instances);
+	}
+	if (quad)
+		glDeleteBuffers(1, &quad);
+	if (vao)
+		glDeleteVertexArrays(1, &vao);
+	if (texture)
+		glDeleteTextures(1, &texture);
+
+	vao = quad = instances = texture = 0;
+	capacity = 0;
+	persistent = false;
+	mapped = nullptr;
+	region = 0;
+}
@@ -0,0 +1,551 @@
+/************************************************************************
+     File:        ParticleSystem.cpp
+
+     Comment:     The fireworks. See ParticleSystem.H
+
+*************************************************************************/
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <algorithm>
+
+#include "ParticleSystem.H"
+
+ParticleSystem::
+ParticleSystem(unsigned int capacity, JobPool* pool)
+	: nOfFires(0), grav(0.00003f), count(0),
+	  jobs(pool ? pool : &JobPool::shared()), running(false), steps(0)
+{
+	launchRandom.state = 1;		// what rand() starts from
+
+	std::vector<float>* floats[] = { &x, &y, &z, &vx, &vy, &vz, &r, &g, &b,
+									 &life, &fade, &sz, &addSpeed, &addCount };
+	for (std::vector<float>* f : floats)
+		f->resize(capacity);
+	fire.resize(capacity);
+	expl.resize(capacity);
+	addParts.resize(capacity);
+	chunks.resize(capacity / CHUNK + 1);
+}
+
+ParticleSystem::
+~ParticleSystem()
+{
+	finish();
+}
+
+void ParticleSystem::
+clear()
+{
+	finish();
+	count = 0;
+	nOfFires = 0;
+}
+
+size_t ParticleSystem::
+reserved() const
+{
+	const std::vector<float>* floats[] = { &x, &y, &z, &vx, &vy, &vz, &r, &g, &b,
+										   &life, &fade, &sz, &addSpeed, &addCount };
+	size_t bytes = 0;
+	for (const std::vector<float>* f : floats)
+		bytes += f->capacity() * sizeof(float);
+	bytes += fire.capacity() + expl.capacity() + addParts.capacity();
+	for (const Chunk& c : chunks)
+		bytes += c.spawned.capacity() * sizeof(Particle) + c.dead.capacity() * sizeof(unsigned int);
+	return bytes + chunks.capacity() * sizeof(Chunk);
+}
+
+void ParticleSystem::
+AddParticle(const Particle& ex)
+{
+	if (count == life.size())
+		return;
+
+	unsigned int i = count++;
+	x[i] = ex.xpos;		y[i] = ex.ypos;		z[i] = ex.zpos;
+	vx[i] = ex.xspeed;	vy[i] = ex.yspeed;	vz[i] = ex.zspeed;
+	r[i] = ex.r;		g[i] = ex.g;		b[i] = ex.b;
+	life[i] = ex.life;
+	fade[i] = ex.fade;
+	sz[i] = ex.size;
+	addSpeed[i] = ex.AddSpeed;
+	addCount[i] = ex.AddCount;
+	fire[i] = ex.bFire;
+	expl[i] = ex.nExpl;
+	addParts[i] = ex.bAddParts;
+}
+
+Particle ParticleSystem::
+get(unsigned int i) const
+{
+	Particle p;
+	p.xpos = x[i];		p.ypos = y[i];		p.zpos = z[i];
+	p.xspeed = vx[i];	p.yspeed = vy[i];	p.zspeed = vz[i];
+	p.r = r[i];			p.g = g[i];			p.b = b[i];
+	p.life = life[i];
+	p.fade = fade[i];
+	p.size = sz[i];
+	p.AddSpeed = addSpeed[i];
+	p.AddCount = addCount[i];
+	p.bFire = fire[i];
+	p.nExpl = expl[i];
+	p.bAddParts = addParts[i];
+	return p;
+}
+
+void ParticleSystem::
+remove(unsigned int i)
+{
+	unsigned int last = --count;
+	if (i == last)
+		return;
+
+	x[i] = x[last];		y[i] = y[last];		z[i] = z[last];
+	vx[i] = vx[last];	vy[i] = vy[last];	vz[i] = vz[last];
+	r[i] = r[last];		g[i] = g[last];		b[i] = b[last];
+	life[i] = life[last];
+	fade[i] = fade[last];
+	sz[i] = sz[last];
+	addSpeed[i] = addSpeed[last];
+	addCount[i] = addCount[last];
+	fire[i] = fire[last];
+	expl[i] = expl[last];
+	addParts[i] = addParts[last];
+}
+
+void ParticleSystem::
+InitParticle(Particle& ep)
+{
+	ep.b = float(launchRandom() % 100) / 60.0f;//顏色隨機
+	ep.g = float(launchRandom() % 100) / 60.0f;
+	ep.r = float(launchRandom() % 100) / 60.0f;
+	ep.life = 1.0f;//初始壽命
+	ep.fade = 0.005f + float(launchRandom() % 21) / 10000.0f;//衰减速度
+	ep.size = 1;//大小  
+	ep.xpos = 400.0f - float(launchRandom() % 8001) / 10.0f;//位置 
+	ep.ypos = 100.0f;
+	ep.zpos = 400.0f - float(launchRandom() % 8001) / 10.0f;
+
+	if (!int(ep.xpos))//x方向速度(z方向相同)
+		ep.xspeed = 0.0f;
+	else
+	{
+		if (ep.xpos < 0)
+		{
+			ep.xspeed = (launchRandom() % int(-ep.xpos)) / 1500.0f;
+		}
+		else
+		{
+			ep.xspeed = -(launchRandom() % int(ep.xpos)) / 1500.0f;
+		}
+	}
+	if (!int(ep.zpos))//x方向速度(z方向相同)
+		ep.zspeed = 0.0f;
+	else
+	{
+		if (ep.zpos < 0)
+		{
+			ep.zspeed = (launchRandom() % int(-ep.zpos)) / 1500.0f;
+		}
+		else
+		{
+			ep.zspeed = -(launchRandom() % int(ep.zpos)) / 1500.0f;
+		}
+	}
+	ep.yspeed = 0.04f + float(launchRandom() % 11) / 1000.0f;//y方向速度(向上)
+
+	ep.bFire = 1;
+	ep.nExpl = 1 + launchRandom() % 6;//粒子效果  
+	ep.bAddParts = 1;//設定有尾巴 
+	ep.AddCount = 0.0f;
+	ep.AddSpeed = 0.2f;
+	nOfFires++;//粒子數+1 
+	AddParticle(ep);//加入粒子列表
+
+}
+
+void ParticleSystem::
+Explosion1(const Particle* par, SparkRandom& rand)
+{
+	Particle ep;
+	for (int i = 0; i < 100; i++)
+	{
+		ep.b = float(rand() % 100) / 60.0f;
+		ep.g = float(rand() % 100) / 60.0f;
+		ep.r = float(rand() % 100) / 60.0f;
+		ep.life = 1.0f;
+		ep.fade = 0.01f + float(rand() % 31) / 10000.0f;
+		ep.size = 0.8f;
+		ep.xpos = par->xpos;
+		ep.ypos = par->ypos;
+		ep.zpos = par->zpos;
+		ep.xspeed = 0.02f - float(rand() % 41) / 1000.0f;
+		ep.yspeed = 0.02f - float(rand() % 41) / 1000.0f;
+		ep.zspeed = 0.02f - float(rand() % 41) / 1000.0f;
+		ep.bFire = 0;
+		ep.nExpl = 0;
+		ep.bAddParts = 0;
+		ep.AddCount = 0.0f;
+		ep.AddSpeed = 0.0f;
+		AddParticle(ep);
+	}
+}
+
+void ParticleSystem::
+Explosion2(const Particle* par, SparkRandom& rand)
+{
+	Particle ep;
+	for (int i = 0; i < 1000; i++)
+	{
+		ep.b = par->b;
+		ep.g = par->g;
+		ep.r = par->r;
+		ep.life = 1.0f;
+		ep.fade = 0.01f + float(rand() % 31) / 10000.0f;
+		ep.size = 0.8f;
+		ep.xpos = par->xpos;
+		ep.ypos = par->ypos;
+		ep.zpos = par->zpos;
+		ep.xspeed = 0.02f - float(rand() % 41) / 1000.0f;
+		ep.yspeed = 0.02f - float(rand() % 41) / 1000.0f;
+		ep.zspeed = 0.02f - float(rand() % 41) / 1000.0f;
+		ep.bFire = 0;
+		ep.nExpl = 0;
+		ep.bAddParts = 0;
+		ep.AddCount = 0.0f;
+		ep.AddSpeed = 0.0f;
+		AddParticle(ep);
+	}
+}
+
+void ParticleSystem::
+Explosion3(const Particle* par, SparkRandom& rand)
+{
+	Particle ep;
+	float PIAsp = 3.1415926 / 180;
+	for (int i = 0; i < 30; i++) {
+		float angle = float(rand() % 360) * PIAsp;
+		ep.b = par->b;
+		ep.g = par->g;
+		ep.r = par->r;
+		ep.life = 1.5f;
+		ep.fade = 0.01f + float(rand() % 31) / 10000.0f;
+		ep.size = 0.8f;
+		ep.xpos = par->xpos;
+		ep.ypos = par->ypos;
+		ep.zpos = par->zpos;
+		ep.xspeed = (float)sin(angle) * 0.01f;
+		ep.yspeed = 0.01f + float(rand() % 11) / 1000.0f;
+		ep.zspeed = (float)cos(angle) * 0.01f;
+		ep.bFire = 0;
+		ep.nExpl = 0;
+		ep.bAddParts = 1;
+		ep.AddCount = 0.0f;
+		ep.AddSpeed = 0.2f;
+		AddParticle(ep);
+	}
+}
+
+void ParticleSystem::
+Explosion4(const Particle* par, SparkRandom& rand)
+{
+	Particle ep;
+	float PIAsp = 3.1415926 / 180;
+	for (int i = 0; i < 30; i++) {
+		float angle = float(rand() % 360) * PIAsp;
+		ep.b = float(rand() % 100) / 60.0f;
+		ep.g = float(rand() % 100) / 60.0f;
+		ep.r = float(rand() % 100) / 60.0f;
+		ep.life = 1.5f;
+		ep.fade = 0.01f + float(rand() % 31) / 10000.0f;
+		ep.size = 0.8f;
+		ep.xpos = par->xpos;
+		ep.ypos = par->ypos;
+		ep.zpos = par->zpos;
+		ep.xspeed = (float)sin(angle) * 0.01f;
+		ep.yspeed = 0.01f + float(rand() % 11) / 1000.0f;
+		ep.zspeed = (float)cos(angle) * 0.01f;
+		ep.bFire = 0;
+		ep.nExpl = 0;
+		ep.bAddParts = 1;
+		ep.AddCount = 0.0f;
+		ep.AddSpeed = 0.2f;
+		AddParticle(ep);
+	}
+}
+
+void ParticleSystem::
+Explosion5(const Particle* par, SparkRandom& rand)
+{
+	Particle ep;
+	for (int i = 0; i < 30; i++) {
+		ep.b = par->b;
+		ep.g = par->g;
+		ep.r = par->r;
+		ep.life = 0.8f;
+		ep.fade = 0.01f + float(rand() % 31) / 10000.0f;
+		ep.size = 0.8f;
+		ep.xpos = par->xpos;
+		ep.ypos = par->ypos;
+		ep.zpos = par->zpos;
+		ep.xspeed = 0.01f - float(rand() % 21) / 1000.0f;
+		ep.yspeed = 0.01f - float(rand() % 21) / 1000.0f;
+		ep.zspeed = 0.01f - float(rand() % 21) / 1000.0f;
+		ep.bFire = 0;
+		ep.nExpl = 7;
+		ep.bAddParts = 0;
+		ep.AddCount = 0.0f;
+		ep.AddSpeed = 0.0f;
+		AddParticle(ep);
+	}
+}
+
+void ParticleSystem::
+Explosion6(const Particle* par, SparkRandom& rand)
+{
+	Particle ep;
+	for (int i = 0; i < 100; i++) {
+		ep.b = float(rand() % 100) / 60.0f;
+		ep.g = float(rand() % 100) / 60.0f;
+		ep.r = float(rand() % 100) / 60.0f;
+		ep.life = 0.8f;
+		ep.fade = 0.01f + float(rand() % 31) / 10000.0f;
+		ep.size = 0.8f;
+		ep.xpos = par->xpos;
+		ep.ypos = par->ypos;
+		ep.zpos = par->zpos;
+		ep.xspeed = 0.01f - float(rand() % 21) / 1000.0f;
+		ep.yspeed = 0.01f - float(rand() % 21) / 1000.0f;
+		ep.zspeed = 0.01f - float(rand() % 21) / 1000.0f;
+		ep.bFire = 0;
+		ep.nExpl = 7;
+		ep.bAddParts = 0;
+		ep.AddCount = 0.0f;
+		ep.AddSpeed = 0.0f;
+		AddParticle(ep);
+	}
+}
+
+void ParticleSystem::
+Explosion7(const Particle* par, SparkRandom& rand)
+{
+	Particle ep;
+	for (int i = 0; i < 10; i++) {
+		ep.b = par->b;
+		ep.g = par->g;
+		ep.r = par->r;
+		ep.life = 0.5f;
+		ep.fade = 0.01f + float(rand() % 31) / 10000.0f;
+		ep.size = 0.6f;
+		ep.xpos = par->xpos;
+		ep.ypos = par->ypos;
+		ep.zpos = par->zpos;
+		ep.xspeed = 0.02f - float(rand() % 41) / 1000.0f;
+		ep.yspeed = 0.02f - float(rand() % 41) / 1000.0f;
+		ep.zspeed = 0.02f - float(rand() % 41) / 1000.0f;
+		ep.bFire = 0;
+		ep.nExpl = 0;
+		ep.bAddParts = 0;
+		ep.AddCount = 0.0f;
+		ep.AddSpeed = 0.0f;
+		AddParticle(ep);
+	}
+}
+
+//****************************************************************************
+//
+// * Run the steps on the pool and return straight away. Nothing may
+//   touch the particles until finish(). After a stall (the window
+//   minimized, say) the backlog is dropped rather than run all at once,
+//   which would hold up the next frame's finish().
+//============================================================================
+void ParticleSystem::
+start(float DTick, unsigned int n)
+//============================================================================
+{
+	finish();
+	if (!n)
+		return;
+	n = std::min(n, (unsigned int)MAX_PARTICLE_STEPS);
+	running = true;
+	jobs->run(stepGroup, [this, DTick, n] {
+		for (unsigned int i = 0; i < n; ++i)
+			step(DTick);
+	});
+}
+
+//****************************************************************************
+//
+// * wait for the step start() began, if there is one
+//============================================================================
+void ParticleSystem::
+finish()
+//============================================================================
+{
+	if (running) {
+		jobs->wait(stepGroup);
+		running = false;
+	}
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void ParticleSystem::
+update(float DTick)
+//============================================================================
+{
+	finish();
+	step(DTick);
+}
+
+//****************************************************************************
+//
+// * The particles alive at the start are cut into chunks of CHUNK that
+//   are simulated in parallel, each writing what it spawns and which of
+//   its particles died into its own Chunk. The chunks are then merged in
+//   order - the dead dropped back to front, so whatever is moved into a
+//   hole is alive, then the new particles appended, the bursts expanded
+//   on the way - which gives the same result however many threads there
+//   are. Particles spawned in
+//   this step are left alone until the next one, like they always were.
+//============================================================================
+void ParticleSystem::
+step(float DTick)
+//============================================================================
+{
+	Particle ep;
+	if (nOfFires < MAX_FIRES)
+	{
+		InitParticle(ep);
+	}
+
+	const unsigned int n = count;
+	const unsigned int nChunks = (n + CHUNK - 1) / CHUNK;
+	if (chunks.size() < nChunks)
+		chunks.resize(nChunks);		// sized by Chunk(), before the jobs
+	++steps;
+
+	jobs->parallelFor(nChunks, [this, n, DTick](unsigned int k) {
+		simulate(k, n, DTick);
+	});
+
+	for (unsigned int k = nChunks; k-- > 0; ) {
+		Chunk& c = chunks[k];
+		nOfFires -= c.firesOut;
+		for (unsigned int j = c.nDead; j-- > 0; )
+			remove(c.dead[j]);
+	}
+	for (unsigned int k = 0; k < nChunks; ++k) {
+		Chunk& c = chunks[k];
+		for (unsigned int j = 0; j < c.nSpawned; ++j) {
+			const Particle& p = c.spawned[j];
+			switch (p.nExpl)
+			{
+			case 0:
+				AddParticle(p);
+				break;
+			case 1:
+				Explosion1(&p, c.rand);
+				break;
+			case 2:
+				Explosion2(&p, c.rand);
+				break;
+			case 3:
+				Explosion3(&p, c.rand);
+				break;
+			case 4:
+				Explosion4(&p, c.rand);
+				break;
+			case 5:
+				Explosion5(&p, c.rand);
+				break;
+			case 6:
+				Explosion6(&p, c.rand);
+				break;
+			case 7:
+				Explosion7(&p, c.rand);
+				break;
+			default:
+				break;
+			}
+		}
+	}
+}
+
+//****************************************************************************
+//
+// * Chunk k of the first n particles, in two passes: the integration
+//   (branch free, so it vectorizes), then the explosions and tails.
+//   Runs on any thread, so it only writes its own particles and chunk.
+//============================================================================
+void ParticleSystem::
+simulate(unsigned int k, unsigned int n, float DTick)
+//============================================================================
+{
+	Chunk& out = chunks[k];
+	out.nSpawned = 0;
+	out.nDead = 0;
+	out.firesOut = 0;
+	out.rand.state = (unsigned int)steps * 2654435761u ^ k * 2246822519u;
+
+	const unsigned int begin = k * CHUNK;
+	const unsigned int end = (n - begin < CHUNK) ? n : begin + CHUNK;
+
+	Particle ep;
+	const float decay = DTick * 0.1f;
+	const float fall = grav * DTick;
+	const float grow = 0.01f * DTick;
+
+	float* __restrict px = x.data();
+	float* __restrict py = y.data();
+	float* __restrict pz = z.data();
+	float* __restrict pvy = vy.data();
+	float* __restrict pl = life.data();
+	float* __restrict pc = addCount.data();
+	const float* __restrict pvx = vx.data();
+	const float* __restrict pvz = vz.data();
+	const float* __restrict pf = fade.data();
+	const char* __restrict pa = addParts.data();
+
+	for (unsigned int i = begin; i < end; ++i) {
+		pl[i] -= pf[i] * decay;//Particle壽命衰減 
+		float alive = (pl[i] > 0.05f) ? 1.0f : 0.0f;	// the dying ones stay put to explode
+		float dt = DTick * alive;
+		px[i] += pvx[i] * dt;
+		py[i] += pvy[i] * dt;
+		pz[i] += pvz[i] * dt;
+		pvy[i] -= fall * alive;
+		pc[i] += grow * alive * (float)pa[i];//AddCount變化愈慢，尾巴粒子愈小  
+	}
+
+	for (unsigned int i = begin; i < end; ++i) {
+		if (life[i] <= 0.05f)
+		{//當壽命小於一定值
+			out.dead[out.nDead++] = i;
+			if (expl[i])//爆炸效果, when the chunks are merged
+				out.spawned[out.nSpawned++] = get(i);
+			if (fire[i])
+				out.firesOut++;
+		}
+		else if (addParts[i] && addCount[i] > addSpeed[i])
+		{//AddSpeed愈大，尾巴粒子愈小  
+			addCount[i] = 0;
+			ep.b = b[i];  ep.g = g[i];  ep.r = r[i];
+			ep.life = life[i] - 0.01f;//壽命變短  
+			ep.fade = fade[i] * 7.0f;//衰减快一些  
+			ep.size = 0.6f;//粒子尺寸小一些  
+			ep.xpos = x[i];  ep.ypos = y[i];  ep.zpos = z[i];
+			ep.xspeed = 0.0f;    ep.yspeed = 0.0f;  ep.zspeed = 0.0f;
+			ep.bFire = 0;
+			ep.nExpl = 0;
+			ep.bAddParts = 0;//尾巴粒子没有尾巴  
+			ep.AddCount = 0.0f;
+			ep.AddSpeed = 0.0f;
+			out.spawned[out.nSpawned++] = ep;
+		}
+	}
+}
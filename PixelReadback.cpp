@@ -0,0 +1,185 @@
+/************************************************************************
+     File:        PixelReadback.cpp
+
+     Comment:     Pixel reads through fenced pixel buffers. See
+						PixelReadback.H
+
+*************************************************************************/
+
+#include <utility>
+
+#include "PixelReadback.H"
+
+//****************************************************************************
+//
+// * Constructor
+//============================================================================
+PixelReadback::
+PixelReadback()
+	: oldest(0), inFlight(0)
+//============================================================================
+{
+	for (int i = 0; i < SLOTS; ++i) {
+		slots[i].buffer = 0;
+		slots[i].capacity = 0;
+		slots[i].fence = 0;
+		slots[i].width = slots[i].height = 0;
+		slots[i].bytes = 0;
+	}
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+GLsizeiptr PixelReadback::
+pixelBytes(GLenum format, GLenum type)
+//============================================================================
+{
+	// types that pack a whole pixel
+	switch (type) {
+	case GL_UNSIGNED_INT_24_8:
+	case GL_UNSIGNED_INT_8_8_8_8:
+	case GL_UNSIGNED_INT_8_8_8_8_REV:
+	case GL_UNSIGNED_INT_2_10_10_10_REV:
+	case GL_UNSIGNED_INT_10F_11F_11F_REV:
+		return 4;
+	}
+
+	GLsizeiptr components;
+	switch (format) {
+	case GL_RED: case GL_GREEN: case GL_BLUE: case GL_ALPHA:
+	case GL_RED_INTEGER: case GL_DEPTH_COMPONENT: case GL_STENCIL_INDEX:
+		components = 1;
+		break;
+	case GL_RG: case GL_RG_INTEGER:
+		components = 2;
+		break;
+	case GL_RGB: case GL_BGR: case GL_RGB_INTEGER:
+		components = 3;
+		break;
+	case GL_RGBA: case GL_BGRA: case GL_RGBA_INTEGER:
+		components = 4;
+		break;
+	default:
+		return 0;
+	}
+
+	switch (type) {
+	case GL_BYTE: case GL_UNSIGNED_BYTE:
+		return components;
+	case GL_SHORT: case GL_UNSIGNED_SHORT: case GL_HALF_FLOAT:
+		return components * 2;
+	case GL_INT: case GL_UNSIGNED_INT: case GL_FLOAT:
+		return components * 4;
+	}
+	return 0;
+}
+
+//****************************************************************************
+//
+// * queue the read into the next free slot's buffer, growing it if it
+//   is too small, and fence it. The flush makes sure the fence reaches
+//   the GPU, so a poll that does not wait still sees it signal
+//============================================================================
+bool PixelReadback::
+read(int x, int y, int width, int height, GLenum format, GLenum type, Callback done)
+//============================================================================
+{
+	const GLsizeiptr size = pixelBytes(format, type);
+	if (inFlight == SLOTS || !size || width <= 0 || height <= 0)
+		return false;
+
+	Slot& slot = slots[(oldest + inFlight) % SLOTS];
+	slot.bytes = size * width * height;
+	slot.width = width;
+	slot.height = height;
+	slot.done = std::move(done);
+
+	if (!slot.buffer)
+		glGenBuffers(1, &slot.buffer);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	if (slot.bytes > slot.capacity) {
+		slot.capacity = slot.bytes;
+		glBufferData(GL_PIXEL_PACK_BUFFER, slot.capacity, NULL, GL_STREAM_READ);
+	}
+
+	GLint alignment;
+	glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(x, y, width, height, format, type, (GLvoid*)0);
+	glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
+	++inFlight;
+	return true;
+}
+
+//****************************************************************************
+//
+// * the reads finish in the order they were made, so stop at the first
+//   one that has not. A callback may read() again: its own slot is only
+//   given back after it returns
+//============================================================================
+int PixelReadback::
+poll(bool wait)
+//============================================================================
+{
+	int delivered = 0;
+	while (inFlight) {
+		Slot& slot = slots[oldest];
+		GLenum state;
+		do
+			state = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+				wait ? 1000000000 : 0);
+		while (wait && state == GL_TIMEOUT_EXPIRED);
+		if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED)
+			break;
+
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+		Callback done = std::move(slot.done);
+		slot.done = nullptr;
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.bytes, GL_MAP_READ_BIT);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		if (pixels && done)
+			done(pixels, slot.width, slot.height);
+		if (pixels) {
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		}
+
+		oldest = (oldest + 1) % SLOTS;
+		--inFlight;
+		++delivered;
+	}
+	return delivered;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void PixelReadback::
+release()
+//============================================================================
+{
+	for (int i = 0; i < SLOTS; ++i) {
+		Slot& slot = slots[i];
+		if (slot.fence)
+			glDeleteSync(slot.fence);
+		if (slot.buffer)
+			glDeleteBuffers(1, &slot.buffer);
+		slot.fence = 0;
+		slot.buffer = 0;
+		slot.capacity = 0;
+		slot.done = nullptr;
+	}
+	oldest = 0;
+	inFlight = 0;
+}
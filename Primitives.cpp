@@ -0,0 +1,309 @@
+/************************************************************************
+     File:        Primitives.cpp
+
+     Comment:     Procedural shapes and the cache of their meshes.
+						See Primitives.H
+
+*************************************************************************/
+
+#include <math.h>
+
+#include "Primitives.H"
+
+#define PI 3.1415926f
+
+//****************************************************************************
+//
+// *
+//============================================================================
+const RingTable&
+ringTable(unsigned int segments)
+//============================================================================
+{
+	static std::map<unsigned int, RingTable> tables;
+
+	RingTable& table = tables[segments];
+	if (table.sines.empty()) {
+		table.segments = segments;
+		table.sines.resize(segments + 1);
+		table.cosines.resize(segments + 1);
+		for (unsigned int i = 0; i < segments; ++i) {
+			float a = i * 2 * PI / segments;
+			table.sines[i] = sinf(a);
+			table.cosines[i] = cosf(a);
+		}
+		table.sines[segments] = table.sines[0];
+		table.cosines[segments] = table.cosines[0];
+	}
+	return table;
+}
+
+//****************************************************************************
+//
+// * append one vertex
+//============================================================================
+static void vertex(std::vector<float>& vertices, float x, float y, float z, float nx, float ny, float nz)
+//============================================================================
+{
+	const float v[PRIMITIVE_VERTEX_FLOATS] = { x, y, z, nx, ny, nz };
+	vertices.insert(vertices.end(), v, v + PRIMITIVE_VERTEX_FLOATS);
+}
+
+//****************************************************************************
+//
+// * the apex is repeated for every side so each side gets its own
+//   normal there
+//============================================================================
+void
+buildCone(float radius, float height, float base, unsigned int sides,
+	std::vector<float>& vertices, std::vector<unsigned int>& indices)
+//============================================================================
+{
+	const RingTable& ring = ringTable(sides);
+	const RingTable& half = ringTable(sides * 2);
+	const float length = sqrtf(radius * radius + height * height);
+	const float across = height / length, up = radius / length;
+
+	const unsigned int first = (unsigned int)(vertices.size() / PRIMITIVE_VERTEX_FLOATS);
+	for (unsigned int s = 0; s <= sides; ++s) {
+		float sn = ring.sines[s], cs = ring.cosines[s];
+		vertex(vertices, radius * sn, base, radius * cs, sn * across, up, cs * across);
+
+		// half way round to the next one
+		unsigned int h = (s * 2 + 1) % (sides * 2);
+		sn = half.sines[h];
+		cs = half.cosines[h];
+		vertex(vertices, 0.0f, base + height, 0.0f, sn * across, up, cs * across);
+	}
+	for (unsigned int s = 0; s < sides; ++s) {
+		unsigned int v = first + s * 2;
+		const unsigned int triangle[3] = { v, v + 2, v + 1 };
+		indices.insert(indices.end(), triangle, triangle + 3);
+	}
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void
+buildCylinder(float radius, float bottom, float top, unsigned int sides, bool caps,
+	std::vector<float>& vertices, std::vector<unsigned int>& indices)
+//============================================================================
+{
+	const RingTable& ring = ringTable(sides);
+
+	const unsigned int first = (unsigned int)(vertices.size() / PRIMITIVE_VERTEX_FLOATS);
+	for (unsigned int s = 0; s <= sides; ++s) {
+		float sn = ring.sines[s], cs = ring.cosines[s];
+		vertex(vertices, radius * sn, bottom, radius * cs, sn, 0.0f, cs);
+		vertex(vertices, radius * sn, top, radius * cs, sn, 0.0f, cs);
+	}
+	for (unsigned int s = 0; s < sides; ++s) {
+		unsigned int v = first + s * 2;
+		const unsigned int quad[6] = { v, v + 2, v + 1, v + 1, v + 2, v + 3 };
+		indices.insert(indices.end(), quad, quad + 6);
+	}
+
+	if (caps) {
+		buildDisc(radius, top, true, sides, vertices, indices);
+		buildDisc(radius, bottom, false, sides, vertices, indices);
+	}
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void
+buildDisc(float radius, float y, bool up, unsigned int sides,
+	std::vector<float>& vertices, std::vector<unsigned int>& indices)
+//============================================================================
+{
+	const RingTable& ring = ringTable(sides);
+	const float ny = up ? 1.0f : -1.0f;
+
+	const unsigned int centre = (unsigned int)(vertices.size() / PRIMITIVE_VERTEX_FLOATS);
+	vertex(vertices, 0.0f, y, 0.0f, 0.0f, ny, 0.0f);
+	for (unsigned int s = 0; s <= sides; ++s)
+		vertex(vertices, radius * ring.sines[s], y, radius * ring.cosines[s], 0.0f, ny, 0.0f);
+	for (unsigned int s = 0; s < sides; ++s) {
+		unsigned int v = centre + 1 + s;
+		const unsigned int triangle[3] = { centre, up ? v : v + 1, up ? v + 1 : v };
+		indices.insert(indices.end(), triangle, triangle + 3);
+	}
+}
+
+//****************************************************************************
+//
+// * a grid of rings x sides squares, around the ring one way and around
+//   the tube the other
+//============================================================================
+void
+buildTorus(float ringRadius, float tubeRadius, unsigned int rings, unsigned int sides,
+	std::vector<float>& vertices, std::vector<unsigned int>& indices)
+//============================================================================
+{
+	const RingTable& around = ringTable(rings);
+	const RingTable& tube = ringTable(sides);
+
+	const unsigned int first = (unsigned int)(vertices.size() / PRIMITIVE_VERTEX_FLOATS);
+	for (unsigned int i = 0; i <= rings; ++i)
+		for (unsigned int j = 0; j <= sides; ++j) {
+			// out from the middle of the tube, then up
+			float ox = around.sines[i], oz = around.cosines[i];
+			float nx = ox * tube.cosines[j], ny = tube.sines[j], nz = oz * tube.cosines[j];
+			vertex(vertices, ringRadius * ox + tubeRadius * nx, tubeRadius * ny,
+				ringRadius * oz + tubeRadius * nz, nx, ny, nz);
+		}
+	for (unsigned int i = 0; i < rings; ++i)
+		for (unsigned int j = 0; j < sides; ++j) {
+			unsigned int a = first + i * (sides + 1) + j;
+			unsigned int b = a + sides + 1;
+			const unsigned int quad[6] = { a, b, b + 1, a, b + 1, a + 1 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+}
+
+//****************************************************************************
+//
+// * stacks rows from the top down, of slices squares each; the latitudes
+//   are the first half of a ring of 2 x stacks
+//============================================================================
+void
+buildSphere(float radius, unsigned int slices, unsigned int stacks,
+	std::vector<float>& vertices, std::vector<unsigned int>& indices)
+//============================================================================
+{
+	const RingTable& around = ringTable(slices);
+	const RingTable& down = ringTable(stacks * 2);
+
+	const unsigned int first = (unsigned int)(vertices.size() / PRIMITIVE_VERTEX_FLOATS);
+	for (unsigned int k = 0; k <= stacks; ++k)
+		for (unsigned int s = 0; s <= slices; ++s) {
+			float nx = down.sines[k] * around.sines[s];
+			float ny = down.cosines[k];
+			float nz = down.sines[k] * around.cosines[s];
+			vertex(vertices, radius * nx, radius * ny, radius * nz, nx, ny, nz);
+		}
+	for (unsigned int k = 0; k < stacks; ++k)
+		for (unsigned int s = 0; s < slices; ++s) {
+			unsigned int a = first + k * (slices + 1) + s;
+			unsigned int c = a + slices + 1;
+			const unsigned int quad[6] = { a, c, a + 1, a + 1, c, c + 1 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+PrimitiveCache& PrimitiveCache::
+shared()
+//============================================================================
+{
+	static PrimitiveCache cache;
+	return cache;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+bool PrimitiveCache::Key::
+operator<(const Key& o) const
+//============================================================================
+{
+	if (shape != o.shape)	return shape < o.shape;
+	if (a != o.a)			return a < o.a;
+	if (b != o.b)			return b < o.b;
+	if (m != o.m)			return m < o.m;
+	return n < o.n;
+}
+
+//****************************************************************************
+//
+// * build the mesh of a shape into a new VAO
+//============================================================================
+void PrimitiveCache::
+build(const Key& key, Mesh& mesh)
+//============================================================================
+{
+	std::vector<float> vertices;
+	std::vector<unsigned int> indices;
+	switch (key.shape) {
+	case CONE:		buildCone(key.a, key.b, 0.0f, key.m, vertices, indices);				break;
+	case CYLINDER:	buildCylinder(key.a, -key.b / 2, key.b / 2, key.m, key.n != 0, vertices, indices);	break;
+	case DISC:		buildDisc(key.a, 0.0f, true, key.m, vertices, indices);				break;
+	case TORUS:		buildTorus(key.a, key.b, key.m, key.n, vertices, indices);			break;
+	case SPHERE:	buildSphere(key.a, key.m, key.n, vertices, indices);				break;
+	}
+
+	glGenVertexArrays(1, &mesh.vao);
+	glGenBuffers(1, &mesh.vbo);
+	glGenBuffers(1, &mesh.ebo);
+	mesh.count = (unsigned int)indices.size();
+
+	glBindVertexArray(mesh.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+
+	const GLsizei stride = PRIMITIVE_VERTEX_FLOATS * sizeof(float);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, stride, (GLvoid*)0);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glNormalPointer(GL_FLOAT, stride, (GLvoid*)(3 * sizeof(float)));
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+//****************************************************************************
+//
+// * find the mesh, building it the first time, and draw it
+//============================================================================
+void PrimitiveCache::
+draw(int shape, float a, float b, unsigned int m, unsigned int n)
+//============================================================================
+{
+	Key key;
+	key.shape = shape;
+	key.a = a;
+	key.b = b;
+	key.m = m;
+	key.n = n;
+
+	std::map<Key, Mesh>::iterator it = meshes.find(key);
+	if (it == meshes.end()) {
+		it = meshes.insert(std::make_pair(key, Mesh())).first;
+		build(key, it->second);
+	}
+
+	glBindVertexArray(it->second.vao);
+	glDrawElements(GL_TRIANGLES, it->second.count, GL_UNSIGNED_INT, (GLvoid*)0);
+	glBindVertexArray(0);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void PrimitiveCache::
+release()
+//============================================================================
+{
+	for (std::map<Key, Mesh>::iterator it = meshes.begin(); it != meshes.end(); ++it) {
+		glDeleteVertexArrays(1, &it->second.vao);
+		glDeleteBuffers(1, &it->second.vbo);
+		glDeleteBuffers(1, &it->second.ebo);
+	}
+	meshes.clear();
+}
@@ -0,0 +1,334 @@
+/************************************************************************
+     File:        Profiler.cpp
+
+     Comment:     Per stage CPU and GPU timing of a frame. See Profiler.H
+
+*************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "Profiler.H"
+
+#include <FL/gl.h>
+
+//****************************************************************************
+//
+// * Constructor
+//============================================================================
+Profiler::
+Profiler()
+	: enabled(false), nStages(0), nCounters(0), frame(0), gpuStage(-1)
+//============================================================================
+{
+}
+
+//****************************************************************************
+//
+// * the queries belong to the GL context, which is gone by now - the
+//   owner calls release() while it is still current
+//============================================================================
+Profiler::
+~Profiler()
+//============================================================================
+{
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+int Profiler::
+stage(const char* name)
+//============================================================================
+{
+	for (int i = 0; i < nStages; ++i)
+		if (!strcmp(stages[i].name, name))
+			return i;
+
+	if (nStages == MAX_STAGES)
+		return MAX_STAGES - 1;
+
+	Stage& s = stages[nStages];
+	s.name = name;
+	for (int i = 0; i < HISTORY; ++i) {
+		s.cpu[i] = -1;
+		s.gpu[i] = -1;
+	}
+	for (int i = 0; i < QUERY_SETS; ++i) {
+		s.queries[i] = 0;
+		s.issued[i] = -1;
+	}
+	return nStages++;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+int Profiler::
+counter(const char* name)
+//============================================================================
+{
+	for (int i = 0; i < nCounters; ++i)
+		if (!strcmp(counters[i].name, name))
+			return i;
+
+	if (nCounters == MAX_COUNTERS)
+		return MAX_COUNTERS - 1;
+
+	Counter& c = counters[nCounters];
+	c.name = name;
+	for (int i = 0; i < HISTORY; ++i)
+		c.values[i] = -1;
+	return nCounters++;
+}
+
+//****************************************************************************
+//
+// * read back the queries this frame is about to reuse, if they are
+//   done, and clear this frame's slot in the history
+//============================================================================
+void Profiler::
+beginFrame()
+//============================================================================
+{
+	if (!enabled)
+		return;
+
+	int set = frame % QUERY_SETS;
+	int slot = frame % HISTORY;
+
+	for (int i = 0; i < nStages; ++i) {
+		Stage& s = stages[i];
+		if (s.issued[set] >= 0) {
+			// issued QUERY_SETS frames ago, so it is usually done. If the
+			// GPU is further behind than that, waiting for it would stall
+			// the frame: the query stays issued, so this frame gets no
+			// GPU time for the stage, and it is asked again next time
+			GLuint available = GL_FALSE;
+			glGetQueryObjectuiv(s.queries[set], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available) {
+				GLuint64 ns = 0;
+				glGetQueryObjectui64v(s.queries[set], GL_QUERY_RESULT, &ns);
+				if (frame - s.issued[set] < HISTORY)
+					s.gpu[s.issued[set] % HISTORY] = ns / 1.0e6f;
+				s.issued[set] = -1;
+			}
+		}
+		s.cpu[slot] = -1;
+		s.gpu[slot] = -1;
+	}
+	for (int i = 0; i < nCounters; ++i)
+		counters[i].values[slot] = -1;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void Profiler::
+endFrame()
+//============================================================================
+{
+	if (enabled)
+		++frame;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void Profiler::
+start(int stage)
+//============================================================================
+{
+	Stage& s = stages[stage];
+	int set = frame % QUERY_SETS;
+
+	// only one time elapsed query can run at a time, and each query can
+	// only be used once per frame
+	if (gpuStage < 0 && s.issued[set] < 0) {
+		if (!s.queries[0])
+			glGenQueries(QUERY_SETS, s.queries);
+		glBeginQuery(GL_TIME_ELAPSED, s.queries[set]);
+		s.issued[set] = frame;
+		gpuStage = stage;
+	}
+
+	s.cpuStart = Clock::now();
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void Profiler::
+stop(int stage)
+//============================================================================
+{
+	Stage& s = stages[stage];
+	float ms = std::chrono::duration<float, std::milli>(Clock::now() - s.cpuStart).count();
+
+	// a stage run twice in one frame adds up
+	float& cpu = s.cpu[frame % HISTORY];
+	cpu = (cpu < 0) ? ms : cpu + ms;
+
+	if (gpuStage == stage) {
+		glEndQuery(GL_TIME_ELAPSED);
+		gpuStage = -1;
+	}
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+float Profiler::
+average(const float* times)
+//============================================================================
+{
+	float sum = 0;
+	int n = 0;
+	for (int i = 0; i < HISTORY; ++i)
+		if (times[i] >= 0) {
+			sum += times[i];
+			++n;
+		}
+	return n ? sum / n : 0.0f;
+}
+
+//****************************************************************************
+//
+// * a row per stage: name, averages as text, a bar for each (CPU green,
+//   GPU orange) against a 60 Hz frame, and the recent frames as a graph.
+//   Then a row per counter
+//============================================================================
+void Profiler::
+drawOverlay(int width, int height)
+//============================================================================
+{
+	const float FRAME_MS = 1000.0f / 60.0f;
+	const int ROW = 18, LEFT = 10, TEXT_W = 190, BAR_W = 150, GRAPH_W = HISTORY;
+
+	glPushAttrib(GL_ALL_ATTRIB_BITS);
+	glUseProgram(0);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_TEXTURE_2D);
+	glDisable(GL_STENCIL_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(0, width, 0, height, -1, 1);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+
+	int top = height - 10;
+	int bottom = top - ROW * (nStages + nCounters) - 4;
+
+	glColor4f(0, 0, 0, 0.6f);
+	glRectf((float)LEFT - 4, (float)bottom, (float)(LEFT + TEXT_W + BAR_W + GRAPH_W + 12), (float)top + 2);
+
+	gl_font(FL_HELVETICA, 11);
+	for (int i = 0; i < nStages; ++i) {
+		const Stage& s = stages[i];
+		int y = top - ROW * (i + 1);
+		float cpu = average(s.cpu), gpu = average(s.gpu);
+
+		char text[96];
+		sprintf(text, "%-12s cpu %6.2f  gpu %6.2f", s.name, cpu, gpu);
+		glColor3f(1, 1, 1);
+		gl_draw(text, LEFT, y + 4);
+
+		// bars, half a row each
+		float x0 = (float)(LEFT + TEXT_W);
+		glColor3f(0.3f, 0.9f, 0.3f);
+		glRectf(x0, (float)y + ROW / 2, x0 + BAR_W * std::min(cpu / FRAME_MS, 1.0f), (float)y + ROW - 2);
+		glColor3f(1.0f, 0.6f, 0.2f);
+		glRectf(x0, (float)y + 2, x0 + BAR_W * std::min(gpu / FRAME_MS, 1.0f), (float)y + ROW / 2);
+
+		// the last HISTORY frames, oldest on the left
+		float gx = (float)(LEFT + TEXT_W + BAR_W + 8);
+		const float* series[2] = { s.cpu, s.gpu };
+		for (int k = 0; k < 2; ++k) {
+			if (k == 0)
+				glColor3f(0.3f, 0.9f, 0.3f);
+			else
+				glColor3f(1.0f, 0.6f, 0.2f);
+			glBegin(GL_LINE_STRIP);
+			for (int j = 0; j < HISTORY; ++j) {
+				float t = series[k][(frame + 1 + j) % HISTORY];
+				if (t < 0)
+					t = 0;
+				glVertex2f(gx + j, y + 1 + (ROW - 2) * std::min(t / FRAME_MS, 1.0f));
+			}
+			glEnd();
+		}
+	}
+
+	// the counters, averaged the same way, as text only
+	for (int i = 0; i < nCounters; ++i) {
+		int y = top - ROW * (nStages + i + 1);
+		char text[96];
+		sprintf(text, "%-12s %8.0f / frame", counters[i].name, average(counters[i].values));
+		glColor3f(1, 1, 1);
+		gl_draw(text, LEFT, y + 4);
+	}
+
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopAttrib();
+}
+
+//****************************************************************************
+//
+// * oldest frame first, -1 where a stage did not run or was not measured
+//============================================================================
+bool Profiler::
+dumpCSV(const char* filename) const
+//============================================================================
+{
+	FILE* fp = fopen(filename, "w");
+	if (!fp)
+		return false;
+
+	fprintf(fp, "frame,stage,cpu_ms,gpu_ms\n");
+	long first = (frame > HISTORY) ? frame - HISTORY : 0;
+	for (long f = first; f < frame; ++f)
+		for (int i = 0; i < nStages; ++i) {
+			const Stage& s = stages[i];
+			fprintf(fp, "%ld,%s,%.4f,%.4f\n", f, s.name, s.cpu[f % HISTORY], s.gpu[f % HISTORY]);
+		}
+
+	fclose(fp);
+	return true;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void Profiler::
+release()
+//============================================================================
+{
+	for (int i = 0; i < nStages; ++i) {
+		Stage& s = stages[i];
+		if (s.queries[0])
+			glDeleteQueries(QUERY_SETS, s.queries);
+		for (int k = 0; k < QUERY_SETS; ++k) {
+			s.queries[k] = 0;
+			s.issued[k] = -1;
+		}
+	}
+	gpuStage = -1;
+}
@@ -8,6 +8,8 @@
 #include <sstream>
 #include <iostream>
 #include <vector>
+#include <unordered_map>
+#include <cstring>
 
 
 
@@ -26,8 +28,10 @@ public:
 	//DEFINE_ENUM_FLAG_OPERATORS(Type);
 
 	Type type = NULL_SHADER;
-	// Constructor generates the shader on the fly
-	Shader(const GLchar* vert, const GLchar* tesc, const GLchar* tese, const char* geom, const char* frag)
+	// Constructor generates the shader on the fly. fragLibrary is a second
+	// fragment shader, of functions frag declares and calls (shaders/shadow.frag)
+	Shader(const GLchar* vert, const GLchar* tesc, const GLchar* tese, const char* geom, const char* frag,
+		const char* fragLibrary = nullptr)
 	{
 		std::vector<GLuint> shaders;
 		if (vert)
@@ -55,6 +59,8 @@ public:
 			shaders.push_back(this->compileShader(GL_FRAGMENT_SHADER, this->readCode(frag).c_str()));
 			this->type = (Shader::Type)(this->type | Type::FRAGMENT_SHADER);
 		}
+		if (fragLibrary)
+			shaders.push_back(this->compileShader(GL_FRAGMENT_SHADER, this->readCode(fragLibrary).c_str()));
 		// Shader Program
 		GLint success;
 		GLchar infoLog[512];
@@ -74,13 +80,185 @@ public:
 
 		for (GLuint shader : shaders)
 			glDeleteShader(shader);
+
+		this->reflect();
 	}
 	// Uses the current shader
 	void Use()
 	{
 		glUseProgram(this->Program);
 	}
+
+	// Uniform driver calls made through the setters below, and the ones
+	// they saved: a name found in the tables instead of asked of the
+	// driver, or a value that was already set. Reset once per frame
+	struct CallCounter
+	{
+		unsigned long calls;
+		unsigned long saved;
+		void reset() { calls = saved = 0; }
+	};
+	static CallCounter& counter()
+	{
+		static CallCounter c = { 0, 0 };
+		return c;
+	}
+
+	// The location of an active uniform outside the blocks, -1 if there is
+	// none (inactive or misspelled). Arrays go by their name without [0]
+	GLint uniform(const char* name) const
+	{
+		auto found = this->uniforms.find(name);
+		return found == this->uniforms.end() ? -1 : found->second.location;
+	}
+
+	// Typed setters. They go to the program whether it is in use or not,
+	// and only call the driver when the value changes - so every uniform
+	// of a shader must be set through them, not with glUniform
+	void setInt(const char* name, GLint value)
+	{
+		GLint location;
+		if (this->changed(name, &value, sizeof(value), location))
+			glProgramUniform1i(this->Program, location, value);
+	}
+	void setFloat(const char* name, GLfloat value)
+	{
+		GLint location;
+		if (this->changed(name, &value, sizeof(value), location))
+			glProgramUniform1f(this->Program, location, value);
+	}
+	void setVec3(const char* name, const GLfloat* value)
+	{
+		GLint location;
+		if (this->changed(name, value, 3 * sizeof(GLfloat), location))
+			glProgramUniform3fv(this->Program, location, 1, value);
+	}
+	void setVec4(const char* name, const GLfloat* value)
+	{
+		GLint location;
+		if (this->changed(name, value, 4 * sizeof(GLfloat), location))
+			glProgramUniform4fv(this->Program, location, 1, value);
+	}
+	void setMat4(const char* name, const GLfloat* value)
+	{
+		GLint location;
+		if (this->changed(name, value, 16 * sizeof(GLfloat), location))
+			glProgramUniformMatrix4fv(this->Program, location, 1, GL_FALSE, value);
+	}
+	// count vec4s from the start of an array; not remembered
+	void setVec4Array(const char* name, GLsizei count, const GLfloat* values)
+	{
+		GLint location = this->uniform(name);
+		++counter().saved;
+		if (location < 0 || count <= 0)
+			return;
+		++counter().calls;
+		glProgramUniform4fv(this->Program, location, count, values);
+	}
+
+	// A uniform block of the program, -1 if it has none by that name, and
+	// the byte offset of a member in it (-1 if there is no such member)
+	GLint block(const char* name) const
+	{
+		auto found = this->blocks.find(name);
+		return found == this->blocks.end() ? -1 : (GLint)found->second.index;
+	}
+	GLint blockSize(const char* name) const
+	{
+		auto found = this->blocks.find(name);
+		return found == this->blocks.end() ? 0 : found->second.size;
+	}
+	GLint blockOffset(const char* name, const char* member) const
+	{
+		auto found = this->blocks.find(name);
+		if (found == this->blocks.end())
+			return -1;
+		auto offset = found->second.offsets.find(member);
+		return offset == found->second.offsets.end() ? -1 : offset->second;
+	}
 private:
+	// an active uniform outside the blocks, and what the setters last gave it
+	struct Uniform
+	{
+		GLint location;
+		GLfloat value[16];
+		bool known;
+	};
+	struct Block
+	{
+		GLuint index;
+		GLint size;		// bytes
+		std::unordered_map<std::string, GLint> offsets;
+	};
+
+	std::unordered_map<std::string, Uniform> uniforms;
+	std::unordered_map<std::string, Block> blocks;
+
+	// ask the linked program once for all its uniforms and blocks
+	void reflect()
+	{
+		GLint count = 0, length = 0;
+		glGetProgramInterfaceiv(this->Program, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &count);
+		glGetProgramInterfaceiv(this->Program, GL_UNIFORM_BLOCK, GL_MAX_NAME_LENGTH, &length);
+		std::vector<std::string> blockNames(count);
+		for (GLint i = 0; i < count; ++i)
+		{
+			std::vector<GLchar> name(length + 1);
+			glGetProgramResourceName(this->Program, GL_UNIFORM_BLOCK, i, length + 1, NULL, name.data());
+			const GLenum property = GL_BUFFER_DATA_SIZE;
+			Block b;
+			b.index = i;
+			glGetProgramResourceiv(this->Program, GL_UNIFORM_BLOCK, i, 1, &property, 1, NULL, &b.size);
+			blockNames[i] = name.data();
+			this->blocks[blockNames[i]] = b;
+		}
+
+		glGetProgramInterfaceiv(this->Program, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+		glGetProgramInterfaceiv(this->Program, GL_UNIFORM, GL_MAX_NAME_LENGTH, &length);
+		for (GLint i = 0; i < count; ++i)
+		{
+			std::vector<GLchar> name(length + 1);
+			glGetProgramResourceName(this->Program, GL_UNIFORM, i, length + 1, NULL, name.data());
+			std::string key = name.data();
+			if (key.size() > 3 && key.compare(key.size() - 3, 3, "[0]") == 0)
+				key.resize(key.size() - 3);
+
+			const GLenum properties[3] = { GL_LOCATION, GL_BLOCK_INDEX, GL_OFFSET };
+			GLint values[3];
+			glGetProgramResourceiv(this->Program, GL_UNIFORM, i, 3, properties, 3, NULL, values);
+			if (values[1] >= 0 && values[1] < (GLint)blockNames.size())
+				this->blocks[blockNames[values[1]]].offsets[key] = values[2];
+			else if (values[0] >= 0)
+			{
+				Uniform u;
+				u.location = values[0];
+				u.known = false;
+				this->uniforms[key] = u;
+			}
+		}
+	}
+
+	// whether a setter has to call the driver: the uniform is active and
+	// the value is not the one it already has
+	bool changed(const char* name, const void* value, size_t bytes, GLint& location)
+	{
+		auto found = this->uniforms.find(name);
+		++counter().saved;
+		if (found == this->uniforms.end())
+			return false;
+		Uniform& u = found->second;
+		if (u.known && memcmp(u.value, value, bytes) == 0)
+		{
+			++counter().saved;
+			return false;
+		}
+		memcpy(u.value, value, bytes);
+		u.known = true;
+		location = u.location;
+		++counter().calls;
+		return true;
+	}
+
 	std::string readCode(const GLchar* path)
 	{
 		std::string code;
@@ -136,4 +314,74 @@ private:
 	}
 };
 
+// The members of one of a shader's uniform blocks, in a buffer of their
+// own, laid out as the shader says. A draw keeps one with its own
+// parameters (its material): set() only changes the copy here, bind()
+// uploads it if it changed and binds it to the block's binding point -
+// one driver call when nothing changed
+class UniformBlock
+{
+public:
+	UniformBlock() : buffer(0), binding(0), dirty(false) {}
+
+	// for the block called name in shader, to be bound at binding
+	void create(const Shader& shader, const char* name, GLuint binding)
+	{
+		this->release();
+		this->shader = &shader;
+		this->name = name;
+		this->binding = binding;
+		this->data.assign(shader.blockSize(name), 0);
+		if (this->data.empty())
+			return;
+		glGenBuffers(1, &this->buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, this->buffer);
+		glBufferData(GL_UNIFORM_BUFFER, this->data.size(), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		this->dirty = true;
+	}
+	void set(const char* member, const void* value, size_t bytes)
+	{
+		if (!this->buffer)
+			return;
+		GLint offset = this->shader->blockOffset(this->name.c_str(), member);
+		if (offset < 0 || (size_t)offset + bytes > this->data.size())
+			return;
+		if (memcmp(&this->data[offset], value, bytes) != 0)
+		{
+			memcpy(&this->data[offset], value, bytes);
+			this->dirty = true;
+		}
+	}
+	void bind()
+	{
+		if (!this->buffer)
+			return;
+		if (this->dirty)
+		{
+			glBindBuffer(GL_UNIFORM_BUFFER, this->buffer);
+			glBufferSubData(GL_UNIFORM_BUFFER, 0, this->data.size(), this->data.data());
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+			Shader::counter().calls += 3;
+			this->dirty = false;
+		}
+		glBindBufferBase(GL_UNIFORM_BUFFER, this->binding, this->buffer);
+		++Shader::counter().calls;
+	}
+	void release()
+	{
+		if (this->buffer)
+			glDeleteBuffers(1, &this->buffer);
+		this->buffer = 0;
+		this->data.clear();
+	}
+private:
+	const Shader* shader = nullptr;
+	std::string name;
+	std::vector<unsigned char> data;
+	GLuint buffer;
+	GLuint binding;
+	bool dirty;
+};
+
 #endif
\ No newline at end of file
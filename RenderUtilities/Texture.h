@@ -55,6 +55,12 @@ public:
 		glActiveTexture(GL_TEXTURE0 + bind_unit);
 		glBindTexture(GL_TEXTURE_2D, 0);
 	}
+	// delete the GL texture (copies share the same id, so only once)
+	void release()
+	{
+		glDeleteTextures(1, &this->id);
+		this->id = 0;
+	}
 	glm::ivec2 size;
 private:
 	GLuint id;
@@ -0,0 +1,244 @@
+/************************************************************************
+     File:        ShadowMap.cpp
+
+     Comment:     The depth map of the main light. See ShadowMap.H
+
+*************************************************************************/
+
+#include <math.h>
+
+#include "ShadowMap.H"
+
+// the std140 block of shaders/shadow.frag: two mat4 and a vec4
+#define BLOCK_BYTES ((16 + 16 + 4) * sizeof(float))
+
+//****************************************************************************
+//
+// * r = a b, column major
+//============================================================================
+static void multiply(float* r, const float* a, const float* b)
+//============================================================================
+{
+	for (int c = 0; c < 4; ++c)
+		for (int k = 0; k < 4; ++k)
+			r[c * 4 + k] = a[k] * b[c * 4] + a[4 + k] * b[c * 4 + 1] +
+				a[8 + k] * b[c * 4 + 2] + a[12 + k] * b[c * 4 + 3];
+}
+
+//****************************************************************************
+//
+// * the inverse of a rotation followed by a translation, which is all the
+//   cameras put on the modelview (the arcball and gluLookAt)
+//============================================================================
+static void invertRigid(float* r, const float* m)
+//============================================================================
+{
+	for (int c = 0; c < 3; ++c) {
+		for (int k = 0; k < 3; ++k)
+			r[c * 4 + k] = m[k * 4 + c];
+		r[c * 4 + 3] = 0.0f;
+	}
+	for (int k = 0; k < 3; ++k)
+		r[12 + k] = -(r[k] * m[12] + r[4 + k] * m[13] + r[8 + k] * m[14]);
+	r[15] = 1.0f;
+}
+
+//****************************************************************************
+//
+// * Constructor
+//============================================================================
+ShadowMap::
+ShadowMap()
+	: resolution(2048), pcfRadius(1), bias(0.0005f), extent(250.0f),
+	  fbo(0), depth(0), block(0), builtResolution(0)
+//============================================================================
+{
+	center[0] = center[1] = center[2] = 0.0f;
+	for (int k = 0; k < 16; ++k)
+		worldToMap[k] = eyeToMap[k] = (k % 5) ? 0.0f : 1.0f;
+}
+
+//****************************************************************************
+//
+// * the depth texture, compared by the samplers, and a framebuffer that
+//   only has depth
+//============================================================================
+void ShadowMap::
+create()
+//============================================================================
+{
+	release();
+
+	glGenTextures(1, &depth);
+	glBindTexture(GL_TEXTURE_2D, depth);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, resolution, resolution, 0,
+		GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glGenBuffers(1, &block);
+	glBindBuffer(GL_UNIFORM_BUFFER, block);
+	glBufferData(GL_UNIFORM_BUFFER, BLOCK_BYTES, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	builtResolution = resolution;
+}
+
+//****************************************************************************
+//
+// * the light looks at center from lightDirection, far enough out for
+//   the whole square to be in front of it. The square stays where it is
+//   whatever the camera does, so the shadows don't crawl when it moves
+//============================================================================
+void ShadowMap::
+render(const float lightDirection[3], const std::function<void()>& drawCasters)
+//============================================================================
+{
+	if (!fbo || builtResolution != resolution)
+		create();
+
+	float d[3] = { lightDirection[0], lightDirection[1], lightDirection[2] };
+	float length = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+	for (int k = 0; k < 3; ++k)
+		d[k] /= length;
+
+	// gluLookAt from center + 2 extent d, toward center
+	const float eye[3] = { center[0] + d[0] * 2.0f * extent, center[1] + d[1] * 2.0f * extent,
+		center[2] + d[2] * 2.0f * extent };
+	const float up[3] = { 0.0f, fabsf(d[1]) > 0.99f ? 0.0f : 1.0f, fabsf(d[1]) > 0.99f ? 1.0f : 0.0f };
+	const float f[3] = { -d[0], -d[1], -d[2] };
+	float s[3] = { f[1] * up[2] - f[2] * up[1], f[2] * up[0] - f[0] * up[2], f[0] * up[1] - f[1] * up[0] };
+	length = sqrtf(s[0] * s[0] + s[1] * s[1] + s[2] * s[2]);
+	for (int k = 0; k < 3; ++k)
+		s[k] /= length;
+	const float u[3] = { s[1] * f[2] - s[2] * f[1], s[2] * f[0] - s[0] * f[2], s[0] * f[1] - s[1] * f[0] };
+	const float view[16] = {
+		s[0], u[0], -f[0], 0.0f,
+		s[1], u[1], -f[1], 0.0f,
+		s[2], u[2], -f[2], 0.0f,
+		-(s[0] * eye[0] + s[1] * eye[1] + s[2] * eye[2]),
+		-(u[0] * eye[0] + u[1] * eye[1] + u[2] * eye[2]),
+		f[0] * eye[0] + f[1] * eye[1] + f[2] * eye[2], 1.0f };
+
+	// glOrtho(-extent, extent, -extent, extent, 0, 4 extent)
+	const float projection[16] = {
+		1.0f / extent, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f / extent, 0.0f, 0.0f,
+		0.0f, 0.0f, -1.0f / (2.0f * extent), 0.0f,
+		0.0f, 0.0f, -1.0f, 1.0f };
+
+	// from clip space to the texture: [-1, 1] to [0, 1]
+	const float toTexture[16] = {
+		0.5f, 0.0f, 0.0f, 0.0f,
+		0.0f, 0.5f, 0.0f, 0.0f,
+		0.0f, 0.0f, 0.5f, 0.0f,
+		0.5f, 0.5f, 0.5f, 1.0f };
+
+	float camera[16], cameraInverse[16], lightClip[16];
+	glGetFloatv(GL_MODELVIEW_MATRIX, camera);
+	invertRigid(cameraInverse, camera);
+	multiply(lightClip, projection, view);
+	multiply(worldToMap, toTexture, lightClip);
+	multiply(eyeToMap, worldToMap, cameraInverse);
+
+	// the map must not be bound while it is drawn into
+	glActiveTexture(GL_TEXTURE0 + SHADOW_MAP_UNIT);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+
+	glPushAttrib(GL_ENABLE_BIT | GL_VIEWPORT_BIT | GL_POLYGON_BIT | GL_DEPTH_BUFFER_BIT | GL_CURRENT_BIT);
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadMatrixf(projection);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadMatrixf(view);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glViewport(0, 0, resolution, resolution);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	glDisable(GL_LIGHTING);
+	glDisable(GL_BLEND);
+	glDisable(GL_STENCIL_TEST);
+	glEnable(GL_DEPTH_TEST);
+	glDepthMask(GL_TRUE);
+	// slopes facing away from the light would shadow themselves otherwise
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
+
+	drawCasters();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopMatrix();
+	glPopAttrib();
+
+	glActiveTexture(GL_TEXTURE0 + SHADOW_MAP_UNIT);
+	glBindTexture(GL_TEXTURE_2D, depth);
+	glActiveTexture(GL_TEXTURE0);
+	upload(true);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void ShadowMap::
+disable()
+//============================================================================
+{
+	if (!block)
+		create();
+	upload(false);
+}
+
+//****************************************************************************
+//
+// * the matrices and the filter settings, to SHADOW_MAP_BLOCK
+//============================================================================
+void ShadowMap::
+upload(bool enabled)
+//============================================================================
+{
+	const float params[4] = { 1.0f / resolution, (float)pcfRadius, bias, enabled ? 1.0f : 0.0f };
+
+	glBindBuffer(GL_UNIFORM_BUFFER, block);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, 16 * sizeof(float), worldToMap);
+	glBufferSubData(GL_UNIFORM_BUFFER, 16 * sizeof(float), 16 * sizeof(float), eyeToMap);
+	glBufferSubData(GL_UNIFORM_BUFFER, 32 * sizeof(float), 4 * sizeof(float), params);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, SHADOW_MAP_BLOCK, block);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void ShadowMap::
+release()
+//============================================================================
+{
+	if (fbo)
+		glDeleteFramebuffers(1, &fbo);
+	if (depth)
+		glDeleteTextures(1, &depth);
+	if (block)
+		glDeleteBuffers(1, &block);
+	fbo = depth = block = 0;
+	builtResolution = 0;
+}
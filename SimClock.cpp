@@ -0,0 +1,87 @@
+/************************************************************************
+     File:        SimClock.cpp
+
+     Comment:     The clock everything in the park moves by.
+						See SimClock.H
+
+*************************************************************************/
+
+#include "SimClock.H"
+
+// the longest frame that is caught up on, in wall clock seconds
+static const double MAX_FRAME = 0.25;
+
+//****************************************************************************
+//
+// * Constructor
+//============================================================================
+SimClock::
+SimClock(float rate)
+	: paused(false), scale(1.0f), hz(0), dt(1), accumulator(0), seconds(0), count(0),
+	  single(0), started(false)
+//============================================================================
+{
+	setRate(rate);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void SimClock::
+setRate(float rate)
+//============================================================================
+{
+	if (rate < 1.0f)
+		rate = 1.0f;
+	if (rate == hz)
+		return;
+	hz = rate;
+	dt = 1.0f / hz;
+	if (accumulator > dt)
+		accumulator = dt * 0.999;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+int SimClock::
+advance()
+//============================================================================
+{
+	Clock::time_point now = Clock::now();
+	double wall = started ? std::chrono::duration<double>(now - last).count() : 0.0;
+	last = now;
+	started = true;
+	return advance(wall);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+int SimClock::
+advance(double wall)
+//============================================================================
+{
+	if (wall > MAX_FRAME)
+		wall = MAX_FRAME;
+	if (!paused && scale > 0)
+		accumulator += wall * scale;
+
+	int n = 0;
+	while (accumulator >= dt && n < MAX_STEPS) {
+		accumulator -= dt;
+		++n;
+	}
+	if (n == MAX_STEPS && accumulator >= dt)
+		accumulator = dt * 0.999;	// more than can be caught up on
+
+	n += single;
+	single = 0;
+
+	count += n;
+	seconds += n * (double)dt;
+	return n;
+}
@@ -0,0 +1,179 @@
+/************************************************************************
+     File:        Spline.cpp
+
+     Comment:     Evaluation of the closed curve through the control
+						points of a CTrack. See Spline.H
+
+*************************************************************************/
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <string.h>
+
+#include "Spline.H"
+
+float M_cardinal[4][4]{ { -0.5,  1.5, -1.5,  0.5 },
+						{    1, -2.5,    2, -0.5 },
+						{ -0.5,    0,  0.5,    0 },
+						{    0,    1,    0,    0 } };
+
+float M_b_spline[4][4]{ { -0.1667,    0.5,   -0.5, 0.1667 },
+						{     0.5,     -1,    0.5,      0 },
+						{    -0.5,      0,    0.5,      0 },
+						{  0.1667, 0.6667, 0.1667,      0 } };
+
+// how many samples evalSplineBatch works on at a time - small enough
+// for the scratch arrays to live on the stack
+static const std::size_t BATCH = 64;
+
+//****************************************************************************
+//
+// * the blending weight of control point k as a cubic in t:
+//   w_k(t) = P[k][0] t^3 + P[k][1] t^2 + P[k][2] t + P[k][3]
+//============================================================================
+static void basisPolynomials(int type, float P[4][4])
+//============================================================================
+{
+	if (type == LINEAR) {
+		static const float linear[4][4]{ { 0, 0, -1, 1 },
+										 { 0, 0,  1, 0 },
+										 { 0, 0,  0, 0 },
+										 { 0, 0,  0, 0 } };
+		memcpy(P, linear, sizeof(linear));
+		return;
+	}
+
+	float (*M)[4] = (type == B_SPLINE) ? M_b_spline : M_cardinal;
+	for (int k = 0; k < 4; ++k)
+		for (int j = 0; j < 4; ++j)
+			P[k][j] = M[j][k];
+}
+
+//****************************************************************************
+//
+// * Two passes per block: the first works out the segment and the weights
+//   of every sample with nothing but arithmetic (this is the part that
+//   vectorizes), the second gathers the four control points and blends
+//============================================================================
+void evalSplineBatch(const ControlPoint* points, std::size_t nPoints, int type,
+	const float* u, std::size_t count, const SplineSamples& out)
+//============================================================================
+{
+	if (!nPoints)
+		return;
+
+	float P[4][4];
+	basisPolynomials(type, P);
+
+	const float n = (float)nPoints;
+	const int last = (int)nPoints - 1;
+
+	alignas(32) float w[4][BATCH];
+	alignas(32) float dw[4][BATCH];
+	alignas(32) int seg[BATCH];
+
+	for (std::size_t base = 0; base < count; base += BATCH) {
+		const std::size_t m = (count - base < BATCH) ? count - base : BATCH;
+		const float* __restrict ub = u + base;
+
+		for (std::size_t i = 0; i < m; ++i) {
+			float v = ub[i] - floorf(ub[i]);
+			float f = v * n;
+			int s = (int)f;
+			s = (s > last) ? last : s;		// u just below 1 can round up
+			float t = f - (float)s;
+			seg[i] = s;
+
+			for (int k = 0; k < 4; ++k) {
+				w[k][i] = ((P[k][0] * t + P[k][1]) * t + P[k][2]) * t + P[k][3];
+				dw[k][i] = (3 * P[k][0] * t + 2 * P[k][1]) * t + P[k][2];
+			}
+		}
+
+		for (std::size_t i = 0; i < m; ++i) {
+			float px = 0, py = 0, pz = 0;
+			float tx = 0, ty = 0, tz = 0;
+			float ox = 0, oy = 0, oz = 0;
+
+			std::size_t c = (std::size_t)seg[i];
+			for (int k = 0; k < 4; ++k) {
+				const ControlPoint& cp = points[c];
+				px += cp.pos.x * w[k][i];
+				py += cp.pos.y * w[k][i];
+				pz += cp.pos.z * w[k][i];
+				tx += cp.pos.x * dw[k][i];
+				ty += cp.pos.y * dw[k][i];
+				tz += cp.pos.z * dw[k][i];
+				ox += cp.orient.x * w[k][i];
+				oy += cp.orient.y * w[k][i];
+				oz += cp.orient.z * w[k][i];
+				if (++c == nPoints)
+					c = 0;
+			}
+
+			// same rule as Pnt3f::normalize
+			float l = ox * ox + oy * oy + oz * oz;
+			if (l < .000001f) {
+				ox = 0;	oy = 1;	oz = 0;
+			}
+			else {
+				l = 1.0f / sqrtf(l);
+				ox *= l; oy *= l; oz *= l;
+			}
+
+			const std::size_t j = base + i;
+			out.px[j] = px;	out.py[j] = py;	out.pz[j] = pz;
+			if (out.tx) {
+				out.tx[j] = tx;	out.ty[j] = ty;	out.tz[j] = tz;
+			}
+			if (out.ox) {
+				out.ox[j] = ox;	out.oy[j] = oy;	out.oz[j] = oz;
+			}
+		}
+	}
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void evalSpline(const std::vector<ControlPoint>& points, int type, float u,
+	Pnt3f& pos, Pnt3f& tangent, Pnt3f& orient)
+//============================================================================
+{
+	SplineSamples out;
+	out.px = &pos.x;		out.py = &pos.y;		out.pz = &pos.z;
+	out.tx = &tangent.x;	out.ty = &tangent.y;	out.tz = &tangent.z;
+	out.ox = &orient.x;		out.oy = &orient.y;		out.oz = &orient.z;
+	evalSplineBatch(points.data(), points.size(), type, &u, 1, out);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+Pnt3f evalSplinePoint(const std::vector<ControlPoint>& points, int type, float u)
+//============================================================================
+{
+	Pnt3f pos, tangent, orient;
+	evalSpline(points, type, u, pos, tangent, orient);
+	return pos;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void trackAngles(const Pnt3f& dir, const Pnt3f& up, float& angle_y, float& angle)
+//============================================================================
+{
+	const float toDegrees = 180.0f / (float)M_PI;
+
+	float len = sqrtf(dir.x * dir.x + dir.y * dir.y + dir.z * dir.z);
+	angle_y = (len > 0.0f) ? acosf(dir.x / len) * toDegrees : 0.0f;
+	if ((dir.x < 0 && dir.z > 0) || (dir.x > 0 && dir.z > 0))
+		angle_y = -angle_y;
+
+	len = sqrtf(up.x * up.x + up.y * up.y + up.z * up.z);
+	angle = (len > 0.0f) ? acosf(up.y / len) * toDegrees : 0.0f;
+}
@@ -33,7 +33,7 @@
 // * Constructor
 //============================================================================
 CTrack::
-CTrack() : trainU(0)
+CTrack() : pointsVersion(0), trainU(0)
 //============================================================================
 {
 	resetPoints();
@@ -56,6 +56,19 @@ resetPoints()
 
 	// we had better put the train back at the start of the track...
 	trainU = 0.0;
+
+	pointsChanged();
+}
+
+//****************************************************************************
+//
+// * anything built from the old points is now out of date
+//============================================================================
+void CTrack::
+pointsChanged()
+//============================================================================
+{
+	++pointsVersion;
 }
 
 //****************************************************************************
@@ -154,6 +167,8 @@ readPoints(const char* filename)
 		fclose(fp);
 	}
 	trainU = 0;
+
+	pointsChanged();
 }
 
 //****************************************************************************
@@ -0,0 +1,331 @@
+/************************************************************************
+     File:        TrackMesh.cpp
+
+     Comment:     The geometry of the track, tessellated once and kept
+						on the GPU. See TrackMesh.H
+
+*************************************************************************/
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include <glad/glad.h>
+
+#include "TrackMesh.H"
+#include "ArcLengthTable.H"
+#include "Track.H"
+#include "Spline.H"
+#include "RenderUtilities/Shader.h"
+
+// the box of one sleeper, in its own frame (x along the track)
+static const float sleeperMin[3] = { -1.5f, 0.0f, -5.0f };
+static const float sleeperMax[3] = {  1.5f, 1.0f,  5.0f };
+
+//****************************************************************************
+//
+// * Constructor
+//============================================================================
+TrackMesh::
+TrackMesh()
+	: rails(nullptr), sleepers(nullptr), sleeperCount(0), railWidth(1.0f),
+	  valid(false), builtVersion(0), builtSplineType(-1), builtTrackType(-1), builtSamples(0)
+//============================================================================
+{
+}
+
+//****************************************************************************
+//
+// * Rebuild and re-upload the geometry if it is out of date
+//============================================================================
+bool TrackMesh::
+update(const CTrack& track, const ArcLengthTable& arcLength,
+	int splineType, int trackType, unsigned int samplesPerSegment)
+//============================================================================
+{
+	if (valid &&
+		builtVersion == track.pointsVersion &&
+		builtSplineType == splineType &&
+		builtTrackType == trackType &&
+		builtSamples == samplesPerSegment)
+		return false;
+
+	if (!rails)
+		rails = createRailVAO();
+	if (!sleepers)
+		sleepers = createSleeperVAO();
+
+	std::vector<TrackVertex> verts;
+	buildRails(track, splineType, trackType, samplesPerSegment, verts);
+	rails->count = (unsigned int)verts.size();
+	glBindBuffer(GL_ARRAY_BUFFER, rails->vbo[0]);
+	glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(TrackVertex), verts.data(), GL_STATIC_DRAW);
+
+	// only the transforms change, the box stays the same
+	std::vector<float> transforms;
+	buildSleepers(track, arcLength, splineType, transforms);
+	sleeperCount = (unsigned int)(transforms.size() / 16);
+	glBindBuffer(GL_ARRAY_BUFFER, sleepers->vbo[1]);
+	glBufferData(GL_ARRAY_BUFFER, transforms.size() * sizeof(float), transforms.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	railWidth = (trackType == PARALLEL) ? 5.0f : 1.0f;
+
+	valid = true;
+	builtVersion = track.pointsVersion;
+	builtSplineType = splineType;
+	builtTrackType = trackType;
+	builtSamples = samplesPerSegment;
+	return true;
+}
+
+//****************************************************************************
+//
+// * Two draw calls for the whole track
+//============================================================================
+void TrackMesh::
+draw(bool doingShadows, Shader* instanceShader)
+//============================================================================
+{
+	if (!valid)
+		return;
+
+	glBindVertexArray(rails->vao);
+	if (!doingShadows)
+		glColor3ub(40, 30, 40);
+	glLineWidth(railWidth);
+	glDrawArrays(GL_LINES, 0, rails->count);
+	glLineWidth(1);
+
+	if (sleeperCount && instanceShader) {
+		const GLfloat color[4] = { 100 / 255.0f, 80 / 255.0f, 100 / 255.0f, 1.0f };
+
+		GLfloat view_matrix[16];
+		GLfloat projection_matrix[16];
+		glGetFloatv(GL_MODELVIEW_MATRIX, view_matrix);
+		glGetFloatv(GL_PROJECTION_MATRIX, projection_matrix);
+
+		instanceShader->Use();
+		instanceShader->setMat4("u_view", view_matrix);
+		instanceShader->setMat4("u_projection", projection_matrix);
+		instanceShader->setVec4("u_color", color);
+		instanceShader->setInt("u_shadow", doingShadows);
+
+		glBindVertexArray(sleepers->vao);
+		glDrawElementsInstanced(GL_TRIANGLES, sleepers->element_amount, GL_UNSIGNED_INT, 0, sleeperCount);
+
+		glUseProgram(0);
+	}
+
+	glBindVertexArray(0);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void TrackMesh::
+release()
+//============================================================================
+{
+	VAO* vaos[2] = { rails, sleepers };
+	for (VAO* v : vaos) {
+		if (!v)
+			continue;
+		glDeleteVertexArrays(1, &v->vao);
+		glDeleteBuffers(2, v->vbo);
+		glDeleteBuffers(1, &v->ebo);
+		delete v;
+	}
+	rails = nullptr;
+	sleepers = nullptr;
+	sleeperCount = 0;
+	valid = false;
+}
+
+//****************************************************************************
+//
+// * one line (or a pair of lines) per sample, the same pieces the old
+//   immediate mode code drew
+//============================================================================
+void TrackMesh::
+buildRails(const CTrack& track, int splineType, int trackType,
+	unsigned int samplesPerSegment, std::vector<TrackVertex>& verts)
+//============================================================================
+{
+	size_t n = track.points.size() * samplesPerSegment;
+
+	// the parameters and the sampled positions and orientations, side by side
+	std::vector<float> soa(7 * n);
+	float* u = soa.data();
+	for (size_t i = 0; i < n; ++i)
+		u[i] = (float)i / n;
+
+	SplineSamples samples;
+	samples.px = u + n;		samples.py = u + 2 * n;	samples.pz = u + 3 * n;
+	samples.ox = u + 4 * n;	samples.oy = u + 5 * n;	samples.oz = u + 6 * n;
+	evalSplineBatch(track.points.data(), track.points.size(), splineType, u, n, samples);
+
+	auto pos = [&](size_t i) { return Pnt3f(samples.px[i], samples.py[i], samples.pz[i]); };
+	auto up = [&](size_t i) { return Pnt3f(samples.ox[i], samples.oy[i], samples.oz[i]); };
+
+	verts.reserve(n * ((trackType == PARALLEL) ? 4 : 2));
+
+	for (size_t i = 0; i < n; ++i) {
+		const Pnt3f q0 = pos(i);
+		const Pnt3f q1 = pos((i + 1) % n);
+		const Pnt3f o = up((i + 1) % n);
+
+		Pnt3f cross_t = (q1 - q0) * o;
+		cross_t.normalize();
+		cross_t = cross_t * RAIL_OFFSET;
+
+		Pnt3f a0 = q0 + cross_t, a1 = q1 + cross_t;
+		Pnt3f b0 = q0 - cross_t, b1 = q1 - cross_t;
+
+		switch (trackType) {
+		case PARALLEL:
+			verts.push_back({ a0.x, a0.y, a0.z, o.x, o.y, o.z });
+			verts.push_back({ a1.x, a1.y, a1.z, o.x, o.y, o.z });
+			verts.push_back({ b0.x, b0.y, b0.z, o.x, o.y, o.z });
+			verts.push_back({ b1.x, b1.y, b1.z, o.x, o.y, o.z });
+			break;
+		case ROAD:
+			verts.push_back({ a0.x, a0.y, a0.z, o.x, o.y, o.z });
+			verts.push_back({ b1.x, b1.y, b1.z, o.x, o.y, o.z });
+			break;
+		default:
+			verts.push_back({ q0.x, q0.y, q0.z, o.x, o.y, o.z });
+			verts.push_back({ q1.x, q1.y, q1.z, o.x, o.y, o.z });
+			break;
+		}
+	}
+}
+
+//****************************************************************************
+//
+// * a transform for a sleeper every SLEEPER_SPACING units - the columns
+//   of the matrix glTranslatef/glRotatef would have built
+//============================================================================
+void TrackMesh::
+buildSleepers(const CTrack& track, const ArcLengthTable& arcLength, int splineType,
+	std::vector<float>& transforms)
+//============================================================================
+{
+	float length = arcLength.length();
+	transforms.reserve((size_t)(length / SLEEPER_SPACING + 1) * 16);
+
+	for (float dist = SLEEPER_SPACING; dist < length; dist += SLEEPER_SPACING) {
+		Pnt3f qt, tangent, orient_t;
+		evalSpline(track.points, splineType, arcLength.paramAt(dist), qt, tangent, orient_t);
+
+		float angle_y, angle;
+		trackAngles(tangent, orient_t, angle_y, angle);
+
+		// rotate(angle_y, y) * rotate(angle, x)
+		float cy = cosf(angle_y * (float)M_PI / 180.0f), sy = sinf(angle_y * (float)M_PI / 180.0f);
+		float cx = cosf(angle * (float)M_PI / 180.0f), sx = sinf(angle * (float)M_PI / 180.0f);
+
+		float m[16] = {
+			cy,			0,		-sy,		0,
+			sy * sx,	cx,		cy * sx,	0,
+			sy * cx,	-sx,	cy * cx,	0,
+			qt.x,		qt.y,	qt.z,		1
+		};
+		transforms.insert(transforms.end(), m, m + 16);
+	}
+}
+
+//****************************************************************************
+//
+// * the rails are drawn with the fixed function pipeline, so the VAO
+//   records client arrays rather than generic attributes
+//============================================================================
+VAO* TrackMesh::
+createRailVAO()
+//============================================================================
+{
+	VAO* v = new VAO;
+	v->count = 0;
+	v->ebo = 0;
+	v->vbo[1] = 0;
+	glGenVertexArrays(1, &v->vao);
+	glGenBuffers(1, &v->vbo[0]);
+
+	glBindVertexArray(v->vao);
+	glBindBuffer(GL_ARRAY_BUFFER, v->vbo[0]);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, sizeof(TrackVertex), (GLvoid*)0);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glNormalPointer(GL_FLOAT, sizeof(TrackVertex), (GLvoid*)(3 * sizeof(float)));
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return v;
+}
+
+//****************************************************************************
+//
+// * one sleeper in its own frame, and the per instance matrix on
+//   attributes 3 to 6 (a mat4 takes four vec4 slots)
+//============================================================================
+VAO* TrackMesh::
+createSleeperVAO()
+//============================================================================
+{
+	// corners of each face (0 = min, 1 = max of the box) and its normal
+	static const int faces[6][4][3] = {
+		{ { 0,0,1 }, { 0,0,0 }, { 1,0,0 }, { 1,0,1 } },		// down
+		{ { 0,1,1 }, { 1,1,1 }, { 1,1,0 }, { 0,1,0 } },		// up
+		{ { 0,0,1 }, { 0,1,1 }, { 0,1,0 }, { 0,0,0 } },		// left
+		{ { 1,0,1 }, { 1,0,0 }, { 1,1,0 }, { 1,1,1 } },		// right
+		{ { 0,0,1 }, { 1,0,1 }, { 1,1,1 }, { 0,1,1 } },		// front
+		{ { 0,0,0 }, { 0,1,0 }, { 1,1,0 }, { 1,0,0 } },		// back
+	};
+	static const float normals[6][3] = {
+		{ 0,-1,0 }, { 0,1,0 }, { -1,0,0 }, { 1,0,0 }, { 0,0,1 }, { 0,0,-1 }
+	};
+
+	std::vector<TrackVertex> verts;
+	std::vector<GLuint> elements;
+	for (int f = 0; f < 6; ++f) {
+		GLuint base = (GLuint)verts.size();
+		for (int c = 0; c < 4; ++c) {
+			float v[3];
+			for (int k = 0; k < 3; ++k)
+				v[k] = faces[f][c][k] ? sleeperMax[k] : sleeperMin[k];
+			verts.push_back({ v[0], v[1], v[2], normals[f][0], normals[f][1], normals[f][2] });
+		}
+		GLuint quad[6] = { base, base + 1, base + 2, base + 2, base + 3, base };
+		elements.insert(elements.end(), quad, quad + 6);
+	}
+
+	VAO* v = new VAO;
+	v->element_amount = (unsigned int)elements.size();
+	glGenVertexArrays(1, &v->vao);
+	glGenBuffers(2, v->vbo);
+	glGenBuffers(1, &v->ebo);
+
+	glBindVertexArray(v->vao);
+
+	glBindBuffer(GL_ARRAY_BUFFER, v->vbo[0]);
+	glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(TrackVertex), verts.data(), GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(TrackVertex), (GLvoid*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(TrackVertex), (GLvoid*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+
+	glBindBuffer(GL_ARRAY_BUFFER, v->vbo[1]);
+	for (int i = 0; i < 4; ++i) {
+		glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float), (GLvoid*)(i * 4 * sizeof(float)));
+		glEnableVertexAttribArray(3 + i);
+		glVertexAttribDivisor(3 + i, 1);
+	}
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, v->ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, elements.size() * sizeof(GLuint), elements.data(), GL_STATIC_DRAW);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return v;
+}
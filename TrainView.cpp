@@ -41,33 +41,14 @@
 #include "Utilities/3DUtils.H"
 #include "Train.H"
 #include "FerrisWheels.H"
+#include "Primitives.H"
+#include "Spline.H"
 
 
 #ifdef EXAMPLE_SOLUTION
 #	include "TrainExample/TrainExample.H"
 #endif
 
-enum splineType
-{
-	LINEAR = 1, CARDINAL, B_SPLINE
-};
-
-enum trackType
-{
-	SIMPLE = 1, PARALLEL, ROAD
-};
-
-
-float M_cardinal[4][4]{ { -0.5,  1.5, -1.5,  0.5 },
-									{    1, -2.5,    2, -0.5 },
-									{ -0.5,    0,  0.5,    0 },
-									{    0,    1,    0,    0 } };
-
-float M_b_spline[4][4]{ { -0.1667,    0.5,   -0.5, 0.1667 },
-						{     0.5,     -1,    0.5,      0 },
-						{    -0.5,      0,    0.5,      0 },
-						{  0.1667, 0.6667, 0.1667,      0 } };
-
 //************************************************************************
 //
 // * Constructor to set up the GL window
@@ -82,6 +63,17 @@ TrainView(int x, int y, int w, int h, const char* l)
 	resetArcball();
 }
 
+//************************************************************************
+//
+// * Destructor
+//========================================================================
+TrainView::
+~TrainView()
+//========================================================================
+{
+	hide();
+}
+
 //************************************************************************
 //
 // * Reset the camera to look at the world
@@ -124,6 +116,9 @@ int TrainView::handle(int event)
 		// if the left button be pushed is left mouse button
 		if (last_push == FL_LEFT_MOUSE) {
 			doPick();
+			// missed the control points, so drop on the water
+			if (selectedCube < 0)
+				addDrop(0.02f, 0.05f);
 			damage(1);
 			return 1;
 		};
@@ -156,6 +151,7 @@ int TrainView::handle(int event)
 			cp->pos.x = (float)rx;
 			cp->pos.y = (float)ry;
 			cp->pos.z = (float)rz;
+			m_pTrack->pointsChanged();
 			damage(1);
 		}
 		break;
@@ -194,6 +190,21 @@ int TrainView::handle(int event)
 	return Fl_Gl_Window::handle(event);
 }
 
+//************************************************************************
+//
+// * from a to b by alpha, for parameters that go round from 1 back to 0
+//========================================================================
+static float lerpLoop(float a, float b, float alpha)
+//========================================================================
+{
+	if (b - a > 0.5f)
+		a += 1.0f;
+	else if (a - b > 0.5f)
+		b += 1.0f;
+	float t = a + (b - a) * alpha;
+	return (t >= 1.0f) ? t - 1.0f : t;
+}
+
 //************************************************************************
 //
 // * this is the code that actually draws the window
@@ -207,38 +218,28 @@ void TrainView::draw()
 	// * Set up basic opengl informaiton
 	//
 	//**********************************************************************
-	//initialized glad
-	if (gladLoadGL())
-	{
-		srand(time(NULL));
-		//initiailize VAO, VBO, Shader...
-		if (!this->skyboxShader)
-			this->initskyboxShader();
+	// loader, shaders, buffers and textures are only made the first time
+	// (and again if the window was hidden, which throws the context away)
+	if (!glReady)
+		initGL();
 
-		if (!this->planeShader)
-			this->initPlaneShader();
+	profiler.enabled = tw->profileButton->value() != 0;
+	profiler.beginFrame();
+	Shader::counter().reset();
 
-		if (!this->heightMapShader)
-			this->initHeightMapShader();
+	// pixels asked for in the last frames that the GPU has got to by now
+	readback.poll();
 
-		if (!this->tilesShader)
-			this->initTilesShader();
+	// the train and the wheel are drawn between the last two steps of the
+	// clock, so they move smoothly however many frames there are a step
+	float alpha = tw->runButton->value() ? tw->simClock.alpha() : 1.0f;
+	draw_t_time = lerpLoop(last_t_time, t_time, alpha);
+	draw_f_time = lerpLoop(last_f_time, f_time, alpha);
 
-		//particles = new Particle();
-		//InitParticle(*particles);
-		nOfFires = 0;
-
-		if (!this->commom_matrices)
-			this->commom_matrices = new UBO();
-		this->commom_matrices->size = 2 * sizeof(glm::mat4);
-		glGenBuffers(1, &this->commom_matrices->ubo);
-		glBindBuffer(GL_UNIFORM_BUFFER, this->commom_matrices->ubo);
-		glBufferData(GL_UNIFORM_BUFFER, this->commom_matrices->size, NULL, GL_STATIC_DRAW);
-		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	{
+		PROFILE_SCOPE(profiler, "fireworks");
+		ProcessParticles();
 	}
-	else
-		throw std::runtime_error("Could not initialize GLAD!");
-	ProcessParticles();
 	// Set up the view port
 	glViewport(0, 0, w(), h());
 
@@ -321,29 +322,24 @@ void TrainView::draw()
 	glEnable(GL_LIGHTING);
 	setupObjects();
 
-	//*********************************************************************
-	// now draw the ground plane
-	//*********************************************************************
 	// set to opengl fixed pipeline(use opengl 1.x draw function)
 	glUseProgram(0);
 
-	setupFloor();
-	glDisable(GL_LIGHTING);
-
 	//*********************************************************************
-	// now draw the object and we need to do it twice
-	// once for real, and then once for shadows
+	// the objects go into the shadow map first, from the light (except
+	// for top view), then they are drawn for real
 	//*********************************************************************
-	glEnable(GL_LIGHTING);
-	setupObjects();
-
-	drawStuff();
+	{
+		PROFILE_SCOPE(profiler, "shadows");
+		if (!tw->topCam->value())
+			shadowMap.render(lightPosition1, [&] { drawStuff(true); });
+		else
+			shadowMap.disable();
+	}
 
-	// this time drawing is for shadows (except for top view)
-	if (!tw->topCam->value()) {
-		setupShadows();
-		drawStuff(true);
-		unsetupShadows();
+	{
+		PROFILE_SCOPE(profiler, "scene");
+		drawStuff();
 	}
 
 	
@@ -351,42 +347,214 @@ void TrainView::draw()
 	glBindBufferRange(
 		GL_UNIFORM_BUFFER, /*binding point*/0, this->commom_matrices->ubo, 0, this->commom_matrices->size);
 
-	drawSkybox();
+	{
+		PROFILE_SCOPE(profiler, "skybox");
+		drawSkybox();
+	}
+
+	{
+		PROFILE_SCOPE(profiler, "plane");
+		drawPlane();
+	}
+
+	{
+		PROFILE_SCOPE(profiler, "water");
+		drawHeightMapWave();
+	}
+
+	{
+		PROFILE_SCOPE(profiler, "particles");
+		DrawParticles();
+	}
 
-	drawPlane();
+	// the particles are on the GPU now, so the steps the clock has taken
+	// since can run on the worker threads while the rest of the frame is
+	// drawn. A tick of the fireworks is half a millisecond
+	fireworks.start(tw->simClock.stepSeconds() * 1000.0f * 0.5f, particleSteps);
+	particleSteps = 0;
 
-	drawHeightMapWave();
+	{
+		PROFILE_SCOPE(profiler, "tiles");
+		drawTiles();
+	}
 
-	DrawParticles();
+	// the uniform calls the frame made, and the ones the tables and the
+	// remembered values of the shaders saved (see Shader.h)
+	static const int uniformCalls = profiler.counter("uniform calls");
+	static const int uniformSaved = profiler.counter("calls saved");
+	profiler.count(uniformCalls, (long)Shader::counter().calls);
+	profiler.count(uniformSaved, (long)Shader::counter().saved);
 
-	drawTiles();
+	profiler.endFrame();
+	if (profiler.enabled)
+		profiler.drawOverlay(w(), h());
 
 	//loadModel();
+}
 
-	//load2Buffer("Obj/body.obj", 0);
-	//
-	//load2Buffer("Obj/ulefthand.obj", 1);
-	//load2Buffer("Obj/dlefthand.obj", 2);
-	//load2Buffer("Obj/lefthand.obj", 3);
-	//load2Buffer("Obj/lshouder.obj", 4);
-	//
-	//load2Buffer("Obj/head.obj", 5);
-	//
-	//load2Buffer("Obj/urighthand.obj", 6);
-	//load2Buffer("Obj/drighthand.obj", 7);
-	//load2Buffer("Obj/righthand.obj", 8);
-	//load2Buffer("Obj/rshouder.obj", 9);
-	//
-	//load2Buffer("Obj/dbody.obj", 11);
-	//load2Buffer("Obj/back2.obj", 10);
-	//
-	//load2Buffer("Obj/uleftleg.obj", 12);
-	//load2Buffer("Obj/dleftleg.obj", 13);
-	//load2Buffer("Obj/leftfoot.obj", 14);
-	//
-	//load2Buffer("Obj/urightleg.obj", 15);
-	//load2Buffer("Obj/drightleg.obj", 16);
-	//load2Buffer("Obj/rightfoot.obj", 17);
+//************************************************************************
+//
+// * create everything the frames draw with - once per GL context
+//========================================================================
+void TrainView::
+initGL()
+//========================================================================
+{
+	//initialized glad
+	if (!gladLoadGL())
+		throw std::runtime_error("Could not initialize GLAD!");
+
+	srand(time(NULL));
+
+	//initiailize VAO, VBO, Shader...
+	if (!this->skyboxShader)
+		this->initskyboxShader();
+
+	if (!this->planeShader)
+		this->initPlaneShader();
+
+	if (!this->heightMapShader)
+		this->initHeightMapShader();
+
+	if (!this->tilesShader)
+		this->initTilesShader();
+
+	if (!this->instancedShader)
+		this->initInstancedShader();
+
+	if (!this->fireworksShader)
+		this->initFireworksShader();
+
+	if (!this->modelShader)
+		this->initGundams();
+
+	if (!this->forest.size())
+		this->forest.load(PROJECT_DIR "/src/forest.txt");
+
+	// a new context starts a new show: the rockets in the air go with
+	// the old one, and their count with them
+	fireworks.clear();
+
+	if (!this->commom_matrices) {
+		this->commom_matrices = new UBO();
+		this->commom_matrices->size = 2 * sizeof(glm::mat4);
+		glGenBuffers(1, &this->commom_matrices->ubo);
+		glBindBuffer(GL_UNIFORM_BUFFER, this->commom_matrices->ubo);
+		glBufferData(GL_UNIFORM_BUFFER, this->commom_matrices->size, NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	glReady = true;
+}
+
+//************************************************************************
+//
+// * free a VAO made by one of the init functions
+//========================================================================
+static void deleteVAO(VAO*& v)
+//========================================================================
+{
+	if (!v)
+		return;
+	glDeleteVertexArrays(1, &v->vao);
+	glDeleteBuffers(MAX_VAO_VBO_AMOUNT, v->vbo);
+	glDeleteBuffers(1, &v->ebo);
+	delete v;
+	v = nullptr;
+}
+
+//************************************************************************
+//
+// * free a shader made by one of the init functions
+//========================================================================
+static void deleteShader(Shader*& s)
+//========================================================================
+{
+	if (!s)
+		return;
+	glDeleteProgram(s->Program);
+	delete s;
+	s = nullptr;
+}
+
+//************************************************************************
+//
+// * give back everything initGL made. the context must be current
+//========================================================================
+void TrainView::
+releaseGL()
+//========================================================================
+{
+	if (!glReady)
+		return;
+
+	deleteShader(skyboxShader);
+	glDeleteVertexArrays(1, &skyboxVAO);
+	glDeleteBuffers(1, &skyboxVBO);
+	glDeleteTextures(1, &cubemapTexture);
+
+	deleteShader(planeShader);
+	planeDraw.release();
+	deleteVAO(plane);
+	if (planeTexture) {
+		planeTexture->release();
+		delete planeTexture;
+		planeTexture = nullptr;
+	}
+
+	deleteShader(heightMapShader);
+	heightMapDraw.release();
+	heightMapGrid.release();
+	deleteShader(rippleShader);
+	ripples.release();
+	for (Texture2D& texture : heightMapTexture)
+		texture.release();
+	heightMapTexture.clear();
+
+	deleteShader(tilesShader);
+	tilesDraw.release();
+	deleteVAO(tiles);
+	if (tilesTexture) {
+		tilesTexture->release();
+		delete tilesTexture;
+		tilesTexture = nullptr;
+	}
+
+	deleteShader(instancedShader);
+	deleteShader(fireworksShader);
+	deleteShader(modelShader);
+	trackMesh.release();
+	gundams.release();
+	forest.release();
+	ferris_wheel.release();
+	PrimitiveCache::shared().release();
+	fireworksRenderer.release();
+	profiler.release();
+	readback.release();
+	shadowMap.release();
+
+	if (commom_matrices) {
+		glDeleteBuffers(1, &commom_matrices->ubo);
+		delete commom_matrices;
+		commom_matrices = nullptr;
+	}
+
+	glReady = false;
+}
+
+//************************************************************************
+//
+// * hiding the window destroys its context, so free the GL objects first
+//========================================================================
+void TrainView::
+hide()
+//========================================================================
+{
+	if (shown() && glReady) {
+		make_current();
+		releaseGL();
+	}
+	Fl_Gl_Window::hide();
 }
 
 //************************************************************************
@@ -434,78 +602,20 @@ setProjection()
 #ifdef EXAMPLE_SOLUTION
 		trainCamView(this, aspect);
 #endif
-		int splineType = -1;
-
-		splineType = tw->splineBrowser->value();
-
-		Pnt3f qt, orient_t;
-		Pnt3f new_qt, new_orient_t;
-
-		int side = t_time * m_pTrack->points.size();
-		float t = t_time * m_pTrack->points.size() - side;
-
-		float new_t_time = t_time + (float)1 / m_pTrack->points.size() / (DIVIDE_LINE / 40);
+		// where the train is and a little way ahead of it, in one batch
+		float new_t_time = draw_t_time + (float)1 / m_pTrack->points.size() / (DIVIDE_LINE / 40);
 		if (new_t_time > 1.0f)
 			new_t_time -= 1.0f;
 
-		int new_side = new_t_time * m_pTrack->points.size();
-		float new_t = new_t_time * m_pTrack->points.size() - new_side;
-
-		float T[4]{ pow(t, 3), pow(t, 2), t, 1 };
-		float new_T[4]{ pow(new_t, 3), pow(new_t, 2), new_t, 1 };
-
-		float C[4]{ 0 };
-		float new_C[4]{ 0 };
-
-		//pos
-		Pnt3f cp_pos_p1 = m_pTrack->points[side].pos;
-		Pnt3f cp_pos_p2 = m_pTrack->points[(side + 1) % m_pTrack->points.size()].pos;
-		Pnt3f cp_pos_p3 = m_pTrack->points[(side + 2) % m_pTrack->points.size()].pos;
-		Pnt3f cp_pos_p4 = m_pTrack->points[(side + 3) % m_pTrack->points.size()].pos;
-		//orient
-		Pnt3f cp_orient_p1 = m_pTrack->points[side].orient;
-		Pnt3f cp_orient_p2 = m_pTrack->points[(side + 1) % m_pTrack->points.size()].orient;
-		Pnt3f cp_orient_p3 = m_pTrack->points[(side + 2) % m_pTrack->points.size()].orient;
-		Pnt3f cp_orient_p4 = m_pTrack->points[(side + 3) % m_pTrack->points.size()].orient;
+		float u[2]{ draw_t_time, new_t_time };
+		float x[2], y[2], z[2];
+		SplineSamples samples;
+		samples.px = x;	samples.py = y;	samples.pz = z;
+		evalSplineBatch(m_pTrack->points.data(), m_pTrack->points.size(),
+			tw->splineBrowser->value(), u, 2, samples);
 
-		//pos
-		Pnt3f new_cp_pos_p1 = m_pTrack->points[new_side].pos;
-		Pnt3f new_cp_pos_p2 = m_pTrack->points[(new_side + 1) % m_pTrack->points.size()].pos;
-		Pnt3f new_cp_pos_p3 = m_pTrack->points[(new_side + 2) % m_pTrack->points.size()].pos;
-		Pnt3f new_cp_pos_p4 = m_pTrack->points[(new_side + 3) % m_pTrack->points.size()].pos;
-
-		Pnt3f forward, up;
-
-		switch (splineType)
-		{
-		case splineType::LINEAR:
-			qt = (1 - t) * cp_pos_p1 + t * cp_pos_p2;
-			orient_t = (1 - t) * cp_orient_p1 + t * cp_orient_p2;
-
-			new_qt = (1 - new_t) * new_cp_pos_p1 + new_t * new_cp_pos_p2;
-			break;
-		case splineType::CARDINAL:
-			Mult_Q(C, M_cardinal, T);
-			qt = cp_pos_p1 * C[0] + cp_pos_p2 * C[1] + cp_pos_p3 * C[2] + cp_pos_p4 * C[3];
-			orient_t = cp_orient_p1 * C[0] + cp_orient_p2 * C[1] + cp_orient_p3 * C[2] + cp_orient_p4 * C[3];
-
-			Mult_Q(new_C, M_cardinal, new_T);
-			new_qt = new_cp_pos_p1 * new_C[0] + new_cp_pos_p2 * new_C[1] + new_cp_pos_p3 * new_C[2] + new_cp_pos_p4 * new_C[3];
-			break;
-		case splineType::B_SPLINE:
-			Mult_Q(C, M_b_spline, T);
-			qt = cp_pos_p1 * C[0] + cp_pos_p2 * C[1] + cp_pos_p3 * C[2] + cp_pos_p4 * C[3];
-			orient_t = cp_orient_p1 * C[0] + cp_orient_p2 * C[1] + cp_orient_p3 * C[2] + cp_orient_p4 * C[3];
-
-			Mult_Q(new_C, M_b_spline, new_T);
-			new_qt = new_cp_pos_p1 * new_C[0] + new_cp_pos_p2 * new_C[1] + new_cp_pos_p3 * new_C[2] + new_cp_pos_p4 * new_C[3];
-			break;
-		}
-
-		orient_t.normalize();
-
-		Pnt3f cross_t = (new_qt - qt) * orient_t;
-		cross_t.normalize();
+		Pnt3f qt(x[0], y[0], z[0]);
+		Pnt3f new_qt(x[1], y[1], z[1]);
 
 		glMatrixMode(GL_MODELVIEW);
 		glLoadIdentity();
@@ -574,40 +684,14 @@ void TrainView::drawStuff(bool doingShadows)
 	{
 		glPushMatrix();
 		glScalef(5.0f, 5.0f, 5.0f);
-		glTranslatef(20.0f, 7.0f, 20.0f);
+		glTranslatef(20.0f, ferris_wheel.height(), 20.0f);
 		glRotatef(90.0f, 0.0f, 1.0f, 0.0f);
-		ferris_wheel.draw(doingShadows, f_time);
+		ferris_wheel.draw(doingShadows, draw_f_time, instancedShader);
 		glPopMatrix();
 
-		for (int i = 1; i < 10; ++i)
-		{
-			trees->draw(glm::vec3(i * 20, 0.0f, 180.0f));
-			trees->draw(glm::vec3(180.f, 0.0f, i * 20));
-
-			trees->draw(glm::vec3(-i * 20, 0.0f, 180.0f));
-			trees->draw(glm::vec3(180.f, 0.0f, -i * 20));
-
-			trees->draw(glm::vec3(-i * 20, 0.0f, -180.0f));
-			trees->draw(glm::vec3(-180.f, 0.0f, -i * 20));
+		drawGundams(doingShadows);
 
-			trees->draw(glm::vec3(i * 20, 0.0f, -180.0f));
-			trees->draw(glm::vec3(-180.f, 0.0f, i * 20));
-		}
-
-		for (int i = 9; i >= 4; --i)
-		{
-			trees->draw(glm::vec3(20.0f, 0.0f, i * 20));
-			trees->draw(glm::vec3(i * 20, 0.0f, 20.0f));
-
-			trees->draw(glm::vec3(20.0f, 0.0f, -i * 20));
-			trees->draw(glm::vec3(-i * 20, 0.0f, 20.0f));
-
-			trees->draw(glm::vec3(-20.0f, 0.0f, -i * 20));
-			trees->draw(glm::vec3(-i * 20, 0.0f, -20.0f));
-
-			trees->draw(glm::vec3(-20.0f, 0.0f, i * 20));
-			trees->draw(glm::vec3(i * 20, 0.0f, -20.0f));
-		}
+		forest.draw(doingShadows, instancedShader);
 	}
 }
 
@@ -698,267 +782,41 @@ void TrainView::setUBO()
 }
 
 #define PI 3.14159265
+//************************************************************************
+//
+// * the track geometry lives in a vertex buffer that is only rebuilt
+//   when the points, the spline type or the track type change
+//========================================================================
 void TrainView::
 drawTrack(bool doingShadow)
+//========================================================================
 {
-	int splineType = -1;
-
-	splineType = tw->splineBrowser->value();
-
-	float distance = 0;
-
-	for (size_t i = 0; i < m_pTrack->points.size(); ++i)
-	{
-		//pos
-		Pnt3f cp_pos_p1 = m_pTrack->points[i].pos;
-		Pnt3f cp_pos_p2 = m_pTrack->points[(i + 1) % m_pTrack->points.size()].pos;
-		Pnt3f cp_pos_p3 = m_pTrack->points[(i + 2) % m_pTrack->points.size()].pos;
-		Pnt3f cp_pos_p4 = m_pTrack->points[(i + 3) % m_pTrack->points.size()].pos;
-
-		//orient
-		Pnt3f cp_orient_p1 = m_pTrack->points[i].orient;
-		Pnt3f cp_orient_p2 = m_pTrack->points[(i + 1) % m_pTrack->points.size()].orient;
-		Pnt3f cp_orient_p3 = m_pTrack->points[(i + 2) % m_pTrack->points.size()].orient;
-		Pnt3f cp_orient_p4 = m_pTrack->points[(i + 3) % m_pTrack->points.size()].orient;
-
-		float percent = 1.0f / DIVIDE_LINE;
-		float t = 0;
-		Pnt3f qt, orient_t;
-
-		switch (splineType)
-		{
-		case splineType::LINEAR:
-			qt = (1 - t) * cp_pos_p1 + t * cp_pos_p2;
-			break;
-		case splineType::CARDINAL:
-			qt = cp_pos_p2;
-			break;
-		case splineType::B_SPLINE:
-			qt = cp_pos_p1 * (1.0f / 6.0f) + cp_pos_p2 * (4.0f / 6.0f) + cp_pos_p3 * (1.0f / 6.0f);
-			break;
-		}
-
-		for (size_t j = 0; j < DIVIDE_LINE; ++j)
-		{
-			Pnt3f qt0 = qt;
-			t += percent;
-
-			float G[3][4]{ { cp_pos_p1.x, cp_pos_p2.x, cp_pos_p3.x, cp_pos_p4.x },
-						   { cp_pos_p1.y, cp_pos_p2.y, cp_pos_p3.y, cp_pos_p4.y },
-						   { cp_pos_p1.z, cp_pos_p2.z, cp_pos_p3.z, cp_pos_p4.z } };
-
-			float T[4]{ pow(t, 3), pow(t, 2), t, 1 };
-
-			float C[4]{ 0 };
-
-			float* dif = new float[4]{ 0 };
-			Pnt3f tangent;
-
-			switch (splineType)
-			{
-			case splineType::LINEAR:
-				qt = (1 - t) * cp_pos_p1 + t * cp_pos_p2;
-				orient_t = (1 - t) * cp_orient_p1 + t * cp_orient_p2;
-
-				tangent = Pnt3f(cp_pos_p2.x - cp_pos_p1.x, cp_pos_p2.y - cp_pos_p1.y, cp_pos_p2.z - cp_pos_p1.z);
-				break;
-			case splineType::CARDINAL:
-				Mult_Q(C, M_cardinal, T);
-				qt = cp_pos_p1 * C[0] + cp_pos_p2 * C[1] + cp_pos_p3 * C[2] + cp_pos_p4 * C[3];
-				orient_t = cp_orient_p1 * C[0] + cp_orient_p2 * C[1] + cp_orient_p3 * C[2] + cp_orient_p4 * C[3];
-
-				differential(dif, M_cardinal, t);
-
-				tangent = cp_pos_p1 * dif[0] + cp_pos_p2 * dif[1] + cp_pos_p3 * dif[2] + cp_pos_p4 * dif[3];
-				break;
-			case splineType::B_SPLINE:
-				Mult_Q(C, M_b_spline, T);
-				qt = cp_pos_p1 * C[0] + cp_pos_p2 * C[1] + cp_pos_p3 * C[2] + cp_pos_p4 * C[3];
-				orient_t = cp_orient_p1 * C[0] + cp_orient_p2 * C[1] + cp_orient_p3 * C[2] + cp_orient_p4 * C[3];
-
-				differential(dif, M_b_spline, t);
-
-				tangent = cp_pos_p1 * dif[0] + cp_pos_p2 * dif[1] + cp_pos_p3 * dif[2] + cp_pos_p4 * dif[3];
-				break;
-			}
-
-			Pnt3f qt1 = qt;
-
-			if (i == 0 && j == 0)
-			{
-				totalDistance = 0.0f;
-				if (!doingShadow)
-					totalDistance += sqrtf(pow(qt1.x - qt0.x, 2) + pow(qt1.y - qt0.y, 2) + pow(qt1.z - qt0.z, 2));
-			}
-
-			orient_t.normalize();
-
-			Pnt3f cross_t = (qt1 - qt0) * orient_t;
-			cross_t.normalize();
-			cross_t = cross_t * 2.5f;
-
-			tangent.normalize();
-
-			int trackType = tw->trackBrowser->value();
-
-			switch (trackType)
-			{
-			case trackType::SIMPLE:
-				glBegin(GL_LINES);
-				if (!doingShadow)
-					glColor3ub(40, 30, 40);
-				glVertex3f(qt0.x, qt0.y, qt0.z);
-				glVertex3f(qt1.x, qt1.y, qt1.z);
-				glEnd();
-				glLineWidth(1);
-				break;
-			case trackType::PARALLEL:
-				glBegin(GL_LINES);
-				if (!doingShadow)
-					glColor3ub(40, 30, 40);
-				glVertex3f(qt0.x + cross_t.x, qt0.y + cross_t.y, qt0.z + cross_t.z);
-				glVertex3f(qt1.x + cross_t.x, qt1.y + cross_t.y, qt1.z + cross_t.z);
-
-				glVertex3f(qt0.x - cross_t.x, qt0.y - cross_t.y, qt0.z - cross_t.z);
-				glVertex3f(qt1.x - cross_t.x, qt1.y - cross_t.y, qt1.z - cross_t.z);
-				glEnd();
-				glLineWidth(5);
-				break;
-			case trackType::ROAD:
-				glBegin(GL_LINES);
-				if (!doingShadow)
-					glColor3ub(40, 30, 40);
-				glVertex3f(qt0.x + cross_t.x, qt0.y + cross_t.y, qt0.z + cross_t.z);
-				glVertex3f(qt1.x - cross_t.x, qt1.y - cross_t.y, qt1.z - cross_t.z);
-				glEnd();
-				break;
-			}
-
-			//draw Sleeper
-			distance += sqrtf(pow(qt1.x - qt0.x, 2) + pow(qt1.y - qt0.y, 2) + pow(qt1.z - qt0.z, 2));
-
-			Pnt3f AC, AB;
-
-			AC = Pnt3f(qt1.x - qt0.x, qt1.y - qt0.y, qt1.z - qt0.z);
-			AB = Pnt3f(1.0f, 0.0f, 0.0f);
-
-			float cos_y = (float)(AC.x * AB.x + AC.y * AB.y + AC.z * AB.z)
-				/ (abs(sqrt(pow(AC.x, 2) + pow(AC.y, 2) + pow(AC.z, 2))) * abs(sqrt(pow(AB.x, 2) + pow(AB.y, 2) + pow(AB.z, 2))));
-
-			float angle_y = acos(cos_y) * 180.0 / PI;
-
-			if ((AC.x < 0 && AC.z > 0) || (AC.x > 0 && AC.z > 0))
-				angle_y = -angle_y;
-
-			AB = Pnt3f(0.0f, 1.0f, 0.0f);
-
-			float cos = (float)(orient_t.x * AB.x + orient_t.y * AB.y + orient_t.z * AB.z)
-				/ (abs(sqrt(pow(orient_t.x, 2) + pow(orient_t.y, 2) + pow(orient_t.z, 2))) * abs(sqrt(pow(AB.x, 2) + pow(AB.y, 2) + pow(AB.z, 2))));
-
-			float angle = acos(cos) * 180.0 / PI;
-
-			if (distance > 8)
-			{
-				distance = 0;
-
-				glPushMatrix();
-				glTranslatef(qt1.x, qt1.y, qt1.z);
-				glRotatef(angle_y, 0.0f, 1.0f, 0.0f);
-				glRotatef(angle, 1.0f, 0.0f, 0.0f);
-				drawSleeper(doingShadow);
-				glPopMatrix();
-			}
-		}
-	}
+	updateArcLength();
+	trackMesh.update(*m_pTrack, arcLengthTable,
+		tw->splineBrowser->value(), tw->trackBrowser->value(), DIVIDE_LINE);
+	trackMesh.draw(doingShadow, instancedShader);
 }
 
+//************************************************************************
+//
+// * bring the arc length table up to date with the track and spline type
+//========================================================================
 void TrainView::
-Mult_Q(float* C, float M[][4], float* T)
+updateArcLength()
+//========================================================================
 {
-	for (int i = 0; i < 4; ++i)
-		for (int j = 0; j < 4; ++j)
-			C[i] += M[j][i] * T[j];
+	if (arcLengthTable.update(*m_pTrack, tw->splineBrowser->value(), DIVIDE_LINE))
+		totalDistance = arcLengthTable.length();
 }
 
 void TrainView::
 drawTrain(bool doingShadow)
 {
-	Pnt3f qt, orient_t;
-
-	int splineType = -1;
-
-	splineType = tw->splineBrowser->value();
-
-	int side = t_time * m_pTrack->points.size();
-	float t = t_time * m_pTrack->points.size() - side;
-
-	float T[4]{ pow(t, 3), pow(t, 2), t, 1 };
-
-	float C[4]{ 0 };
-	float* dif = new float[4]{ 0 };
-
-	//pos
-	Pnt3f cp_pos_p1 = m_pTrack->points[side].pos;
-	Pnt3f cp_pos_p2 = m_pTrack->points[(side + 1) % m_pTrack->points.size()].pos;
-	Pnt3f cp_pos_p3 = m_pTrack->points[(side + 2) % m_pTrack->points.size()].pos;
-	Pnt3f cp_pos_p4 = m_pTrack->points[(side + 3) % m_pTrack->points.size()].pos;
-	//orient
-	Pnt3f cp_orient_p1 = m_pTrack->points[side].orient;
-	Pnt3f cp_orient_p2 = m_pTrack->points[(side + 1) % m_pTrack->points.size()].orient;
-	Pnt3f cp_orient_p3 = m_pTrack->points[(side + 2) % m_pTrack->points.size()].orient;
-	Pnt3f cp_orient_p4 = m_pTrack->points[(side + 3) % m_pTrack->points.size()].orient;
+	Pnt3f qt, tangent, orient_t;
+	evalSpline(m_pTrack->points, tw->splineBrowser->value(), draw_t_time, qt, tangent, orient_t);
 
-	Pnt3f tangent;
-
-	Pnt3f AC, AB;
-
-	AB = Pnt3f(1.0f, 0.0f, 0.0f);
-
-	float cos = 0.0f, cos_y = 0.0f;
-
-	float angle = 0.0f, angle_y = 0.0f;
-
-	switch (splineType)
-	{
-	case splineType::LINEAR:
-		qt = (1 - t) * cp_pos_p1 + t * cp_pos_p2;
-		orient_t = (1 - t) * cp_orient_p1 + t * cp_orient_p2;
-
-		tangent = Pnt3f(cp_pos_p2.x - cp_pos_p1.x, cp_pos_p2.y - cp_pos_p1.y, cp_pos_p2.z - cp_pos_p1.z);
-		break;
-	case splineType::CARDINAL:
-		Mult_Q(C, M_cardinal, T);
-		qt = cp_pos_p1 * C[0] + cp_pos_p2 * C[1] + cp_pos_p3 * C[2] + cp_pos_p4 * C[3];
-		orient_t = cp_orient_p1 * C[0] + cp_orient_p2 * C[1] + cp_orient_p3 * C[2] + cp_orient_p4 * C[3];
-
-		differential(dif, M_cardinal, t);
-
-		tangent = cp_pos_p1 * dif[0] + cp_pos_p2 * dif[1] + cp_pos_p3 * dif[2] + cp_pos_p4 * dif[3];
-		break;
-	case splineType::B_SPLINE:
-		Mult_Q(C, M_b_spline, T);
-		qt = cp_pos_p1 * C[0] + cp_pos_p2 * C[1] + cp_pos_p3 * C[2] + cp_pos_p4 * C[3];
-		orient_t = cp_orient_p1 * C[0] + cp_orient_p2 * C[1] + cp_orient_p3 * C[2] + cp_orient_p4 * C[3];
-
-		differential(dif, M_b_spline, t);
-
-		tangent = cp_pos_p1 * dif[0] + cp_pos_p2 * dif[1] + cp_pos_p3 * dif[2] + cp_pos_p4 * dif[3];
-		break;
-	}
-
-	cos_y = (float)(tangent.x * AB.x + tangent.y * AB.y + tangent.z * AB.z)
-		/ (abs(sqrt(pow(tangent.x, 2) + pow(tangent.y, 2) + pow(tangent.z, 2))) * abs(sqrt(pow(AB.x, 2) + pow(AB.y, 2) + pow(AB.z, 2))));
-
-	angle_y = acos(cos_y) * 180.0 / PI;
-	if ((tangent.x < 0 && tangent.z > 0) || (tangent.x > 0 && tangent.z > 0))
-		angle_y = -angle_y;
-
-	AB = Pnt3f(0.0f, 1.0f, 0.0f);
-
-	cos = (float)(orient_t.x * AB.x + orient_t.y * AB.y + orient_t.z * AB.z)
-		/ (abs(sqrt(pow(orient_t.x, 2) + pow(orient_t.y, 2) + pow(orient_t.z, 2))) * abs(sqrt(pow(AB.x, 2) + pow(AB.y, 2) + pow(AB.z, 2))));
-
-	angle = acos(cos) * 180.0 / PI;
+	float angle_y, angle;
+	trackAngles(tangent, orient_t, angle_y, angle);
 
 	glPushMatrix();
 	glTranslatef(qt.x, qt.y + 2.5f, qt.z);
@@ -983,98 +841,10 @@ rotatef(float m[][3], float* p)
 {
 	float* n = new float[] {0, 0, 0};
 	for (int i = 0; i < 3; ++i)
-		for (int j = 0; j < 3; ++j)
-			n[i] += m[i][j] * p[j];
-
-	return n;
-}
-
-void TrainView::
-drawSleeper(bool doingShadow)
-{
-	//Down
-	glBegin(GL_QUADS);
-	if (!doingShadow)
-		glColor3ub(100, 80, 100);
-	glTexCoord2f(0.0f, 0.0f);
-	glVertex3f(-1.5, 0, 5);
-	glTexCoord2f(0.1f, 1.0f);
-	glVertex3f(1.5, 0, 5);
-	glTexCoord2f(1.0f, 1.0f);
-	glVertex3f(1.5, 0, -5);
-	glTexCoord2f(1.0f, 0.0f);
-	glVertex3f(-1.5, 0, -5);
-	glEnd();
-
-	//Up
-	glBegin(GL_QUADS);
-	if (!doingShadow)
-		glColor3ub(100, 80, 100);
-	glTexCoord2f(0.0f, 0.0f);
-	glVertex3f(-1.5, 1, 5);
-	glTexCoord2f(0.1f, 1.0f);
-	glVertex3f(1.5, 1, 5);
-	glTexCoord2f(1.0f, 1.0f);
-	glVertex3f(1.5, 1, -5);
-	glTexCoord2f(1.0f, 0.0f);
-	glVertex3f(-1.5, 1, -5);
-	glEnd();
-
-	//Left
-	glBegin(GL_QUADS);
-	if (!doingShadow)
-		glColor3ub(100, 80, 100);
-	glTexCoord2f(0.0f, 0.0f);
-	glVertex3f(-1.5, 0, 5);
-	glTexCoord2f(0.1f, 1.0f);
-	glVertex3f(-1.5, 1, 5);
-	glTexCoord2f(1.0f, 1.0f);
-	glVertex3f(-1.5, 1, -5);
-	glTexCoord2f(1.0f, 0.0f);
-	glVertex3f(-1.5, 0, -5);
-	glEnd();
-
-	//Right
-	glBegin(GL_QUADS);
-	if (!doingShadow)
-		glColor3ub(100, 80, 100);
-	glTexCoord2f(0.0f, 0.0f);
-	glVertex3f(1.5, 0, 5);
-	glTexCoord2f(0.1f, 1.0f);
-	glVertex3f(1.5, 1, 5);
-	glTexCoord2f(1.0f, 1.0f);
-	glVertex3f(1.5, 1, -5);
-	glTexCoord2f(1.0f, 0.0f);
-	glVertex3f(1.5, 0, -5);
-	glEnd();
-
-	//Front
-	glBegin(GL_QUADS);
-	if (!doingShadow)
-		glColor3ub(100, 80, 100);
-	glTexCoord2f(0.0f, 0.0f);
-	glVertex3f(-1.5, 1, 5);
-	glTexCoord2f(0.1f, 1.0f);
-	glVertex3f(1.5, 1, 5);
-	glTexCoord2f(1.0f, 1.0f);
-	glVertex3f(1.5, 0, 5);
-	glTexCoord2f(1.0f, 0.0f);
-	glVertex3f(-1.5, 0, 5);
-	glEnd();
+		for (int j = 0; j < 3; ++j)
+			n[i] += m[i][j] * p[j];
 
-	//Front
-	glBegin(GL_QUADS);
-	if (!doingShadow)
-		glColor3ub(100, 80, 100);
-	glTexCoord2f(0.0f, 0.0f);
-	glVertex3f(-1.5, 1, -5);
-	glTexCoord2f(0.1f, 1.0f);
-	glVertex3f(1.5, 1, -5);
-	glTexCoord2f(1.0f, 1.0f);
-	glVertex3f(1.5, 0, -5);
-	glTexCoord2f(1.0f, 0.0f);
-	glVertex3f(-1.5, 0, -5);
-	glEnd();
+	return n;
 }
 
 void TrainView::
@@ -1189,47 +959,12 @@ drawCar(bool doingShadow)
 	glPopMatrix();
 }
 
-void  TrainView::
-differential(float* C, float M[][4], float t)
-{
-	float T[4]{ 3 * pow(t, 2), 2 * t, 1, 0 };
-
-	for (int i = 0; i < 4; ++i)
-		for (int j = 0; j < 4; ++j)
-			C[i] += M[j][i] * T[j];
-}
-
 void TrainView::
 drawWheel(bool doingShadow)
 {
-	float x = 0.0f, y = 0.0f, z = 0.0f;
-	float r = 1.5f;
-
-	glBegin(GL_TRIANGLE_FAN);
-	if (!doingShadow)
-		glColor3ub(0, 0, 0);
-	glVertex3f(x, y + 1.0f, z);
-	for (int i = 0; i <= 360; ++i)
-		glVertex3f(x + r * cos(i * PI / 180.0), y + 1.0f, z + r * sin(i * PI / 180.0));
-	glEnd();
-
-	glBegin(GL_TRIANGLE_FAN);
-	if (!doingShadow)
-		glColor3ub(0, 0, 0);
-	glVertex3f(x, y - 1.0f, z);
-	for (int i = 0; i <= 360; ++i)
-		glVertex3f(x + r * cos(i * PI / 180.0), y - 1.0f, z + r * sin(i * PI / 180.0));
-	glEnd();
-
-	glBegin(GL_TRIANGLE_STRIP);
 	if (!doingShadow)
 		glColor3ub(0, 0, 0);
-	for (int i = 0; i <= 360; ++i)
-	{
-		glVertex3f(r * cos(i * PI / 180.0), 1.0f, r * sin(i * PI / 180.0));
-		glVertex3f(r * cos(i * PI / 180.0), -1.0f, r * sin(i * PI / 180.0));
-	}
-	glEnd();
+	PrimitiveCache::shared().drawCylinder(1.5f, 2.0f, 32, true);
 }
 
 unsigned int TrainView::
@@ -1341,7 +1076,7 @@ drawSkybox()
 {
 	glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
 	skyboxShader->Use();
-	glUniform1i(glGetUniformLocation(this->skyboxShader->Program, "skybox"), 0);
+	skyboxShader->setInt("skybox", 0);
 	glm::mat4 view;
 	glm::mat4 projection;
 
@@ -1350,8 +1085,8 @@ drawSkybox()
 	view = glm::mat4(glm::mat3(view)); // remove translation from the view matrix
 
 	glGetFloatv(GL_PROJECTION_MATRIX, &projection[0][0]);
-	glUniformMatrix4fv(glGetUniformLocation(this->skyboxShader->Program, "view"), 1, GL_FALSE, &view[0][0]);
-	glUniformMatrix4fv(glGetUniformLocation(this->skyboxShader->Program, "projection"), 1, GL_FALSE, &projection[0][0]);
+	skyboxShader->setMat4("view", &view[0][0]);
+	skyboxShader->setMat4("projection", &projection[0][0]);
 
 	// skybox cube
 	glBindVertexArray(skyboxVAO);
@@ -1362,428 +1097,25 @@ drawSkybox()
 	glDepthFunc(GL_LESS); // set depth function back to default
 }
 
-void TrainView::
-AddParticle(Particle ex)
-{
-	pParticle p;
-	p = new Particle;//new particle   
-	p->pNext = NULL;        p->pPrev = NULL;
-	p->b = ex.b;  p->g = ex.g;  p->r = ex.r;
-	p->fade = ex.fade;
-	p->life = ex.life;
-	p->size = ex.size;
-	p->xpos = ex.xpos;
-	p->ypos = ex.ypos;
-	p->zpos = ex.zpos;
-	p->xspeed = ex.xspeed;
-	p->yspeed = ex.yspeed;
-	p->zspeed = ex.zspeed;
-	p->AddCount = ex.AddCount;
-	p->AddSpeed = ex.AddSpeed;
-	p->bAddParts = ex.bAddParts;
-	p->bFire = ex.bFire;
-	p->nExpl = ex.nExpl;
-
-	if (!particles)
-	{
-		particles = p;
-		return;
-	}
-	else
-	{
-		particles->pPrev = p;
-		p->pNext = particles;
-		particles = p;
-	}
-}
-
-void TrainView::
-DeleteParticle(pParticle* p)
-{
-	if (!(*p))
-		return;
-
-	if (!(*p)->pNext && !(*p)->pPrev)
-	{
-		delete(*p);
-		*p = NULL;
-		return;
-	}
-
-	pParticle tmp;
-	if (!(*p)->pPrev)
-	{
-		tmp = (*p);
-		*p = (*p)->pNext;
-		particles = *p;
-		(*p)->pPrev = NULL;
-		delete tmp;
-		return;
-	}
-
-	if (!(*p)->pNext)
-	{
-		(*p)->pPrev->pNext = NULL;
-		delete(*p);
-		*p = NULL;
-		return;
-	}
-
-	tmp = (*p);
-	(*p)->pPrev->pNext = (*p)->pNext;
-	(*p)->pNext->pPrev = (*p)->pPrev;
-	*p = (*p)->pNext;
-	delete tmp;
-}
-
-void TrainView::
-DeleteAll(pParticle* Part)
-{
-	while ((*Part))
-		DeleteParticle(Part);
-}
-
-void TrainView::
-InitParticle(Particle& ep)
-{
-	ep.b = float(rand() % 100) / 60.0f;//顏色隨機
-	ep.g = float(rand() % 100) / 60.0f;
-	ep.r = float(rand() % 100) / 60.0f;
-	ep.life = 1.0f;//初始壽命
-	ep.fade = 0.005f + float(rand() % 21) / 10000.0f;//衰减速度
-	ep.size = 1;//大小  
-	ep.xpos = 400.0f - float(rand() % 8001) / 10.0f;//位置 
-	ep.ypos = 100.0f;
-	ep.zpos = 400.0f - float(rand() % 8001) / 10.0f;
-
-	if (!int(ep.xpos))//x方向速度(z方向相同)
-		ep.xspeed = 0.0f;
-	else
-	{
-		if (ep.xpos < 0)
-		{
-			ep.xspeed = (rand() % int(-ep.xpos)) / 1500.0f;
-		}
-		else
-		{
-			ep.xspeed = -(rand() % int(ep.xpos)) / 1500.0f;
-		}
-	}
-	if (!int(ep.zpos))//x方向速度(z方向相同)
-		ep.zspeed = 0.0f;
-	else
-	{
-		if (ep.zpos < 0)
-		{
-			ep.zspeed = (rand() % int(-ep.zpos)) / 1500.0f;
-		}
-		else
-		{
-			ep.zspeed = -(rand() % int(ep.zpos)) / 1500.0f;
-		}
-	}
-	ep.yspeed = 0.04f + float(rand() % 11) / 1000.0f;//y方向速度(向上)
-
-	ep.bFire = 1;
-	ep.nExpl = 1 + rand() % 6;//粒子效果  
-	ep.bAddParts = 1;//設定有尾巴 
-	ep.AddCount = 0.0f;
-	ep.AddSpeed = 0.2f;
-	nOfFires++;//粒子數+1 
-	AddParticle(ep);//加入粒子列表
-
-}
-
-void TrainView::
-Explosion1(Particle* par)
-{
-	Particle ep;
-	for (int i = 0; i < 100; i++)
-	{
-		ep.b = float(rand() % 100) / 60.0f;
-		ep.g = float(rand() % 100) / 60.0f;
-		ep.r = float(rand() % 100) / 60.0f;
-		ep.life = 1.0f;
-		ep.fade = 0.01f + float(rand() % 31) / 10000.0f;
-		ep.size = 0.8f;
-		ep.xpos = par->xpos;
-		ep.ypos = par->ypos;
-		ep.zpos = par->zpos;
-		ep.xspeed = 0.02f - float(rand() % 41) / 1000.0f;
-		ep.yspeed = 0.02f - float(rand() % 41) / 1000.0f;
-		ep.zspeed = 0.02f - float(rand() % 41) / 1000.0f;
-		ep.bFire = 0;
-		ep.nExpl = 0;
-		ep.bAddParts = 0;
-		ep.AddCount = 0.0f;
-		ep.AddSpeed = 0.0f;
-		AddParticle(ep);
-	}
-}
-
-void TrainView::
-Explosion2(Particle* par)
-{
-	Particle ep;
-	for (int i = 0; i < 1000; i++)
-	{
-		ep.b = par->b;
-		ep.g = par->g;
-		ep.r = par->r;
-		ep.life = 1.0f;
-		ep.fade = 0.01f + float(rand() % 31) / 10000.0f;
-		ep.size = 0.8f;
-		ep.xpos = par->xpos;
-		ep.ypos = par->ypos;
-		ep.zpos = par->zpos;
-		ep.xspeed = 0.02f - float(rand() % 41) / 1000.0f;
-		ep.yspeed = 0.02f - float(rand() % 41) / 1000.0f;
-		ep.zspeed = 0.02f - float(rand() % 41) / 1000.0f;
-		ep.bFire = 0;
-		ep.nExpl = 0;
-		ep.bAddParts = 0;
-		ep.AddCount = 0.0f;
-		ep.AddSpeed = 0.0f;
-		AddParticle(ep);
-	}
-}
-
-void TrainView::
-Explosion3(Particle* par)
-{
-	Particle ep;
-	float PIAsp = 3.1415926 / 180;
-	for (int i = 0; i < 30; i++) {
-		float angle = float(rand() % 360) * PIAsp;
-		ep.b = par->b;
-		ep.g = par->g;
-		ep.r = par->r;
-		ep.life = 1.5f;
-		ep.fade = 0.01f + float(rand() % 31) / 10000.0f;
-		ep.size = 0.8f;
-		ep.xpos = par->xpos;
-		ep.ypos = par->ypos;
-		ep.zpos = par->zpos;
-		ep.xspeed = (float)sin(angle) * 0.01f;
-		ep.yspeed = 0.01f + float(rand() % 11) / 1000.0f;
-		ep.zspeed = (float)cos(angle) * 0.01f;
-		ep.bFire = 0;
-		ep.nExpl = 0;
-		ep.bAddParts = 1;
-		ep.AddCount = 0.0f;
-		ep.AddSpeed = 0.2f;
-		AddParticle(ep);
-	}
-}
-
-void TrainView::
-Explosion4(Particle* par)
-{
-	Particle ep;
-	float PIAsp = 3.1415926 / 180;
-	for (int i = 0; i < 30; i++) {
-		float angle = float(rand() % 360) * PIAsp;
-		ep.b = float(rand() % 100) / 60.0f;
-		ep.g = float(rand() % 100) / 60.0f;
-		ep.r = float(rand() % 100) / 60.0f;
-		ep.life = 1.5f;
-		ep.fade = 0.01f + float(rand() % 31) / 10000.0f;
-		ep.size = 0.8f;
-		ep.xpos = par->xpos;
-		ep.ypos = par->ypos;
-		ep.zpos = par->zpos;
-		ep.xspeed = (float)sin(angle) * 0.01f;
-		ep.yspeed = 0.01f + float(rand() % 11) / 1000.0f;
-		ep.zspeed = (float)cos(angle) * 0.01f;
-		ep.bFire = 0;
-		ep.nExpl = 0;
-		ep.bAddParts = 1;
-		ep.AddCount = 0.0f;
-		ep.AddSpeed = 0.2f;
-		AddParticle(ep);
-	}
-}
-
-void TrainView::
-Explosion5(Particle* par)
-{
-	Particle ep;
-	for (int i = 0; i < 30; i++) {
-		ep.b = par->b;
-		ep.g = par->g;
-		ep.r = par->r;
-		ep.life = 0.8f;
-		ep.fade = 0.01f + float(rand() % 31) / 10000.0f;
-		ep.size = 0.8f;
-		ep.xpos = par->xpos;
-		ep.ypos = par->ypos;
-		ep.zpos = par->zpos;
-		ep.xspeed = 0.01f - float(rand() % 21) / 1000.0f;
-		ep.yspeed = 0.01f - float(rand() % 21) / 1000.0f;
-		ep.zspeed = 0.01f - float(rand() % 21) / 1000.0f;
-		ep.bFire = 0;
-		ep.nExpl = 7;
-		ep.bAddParts = 0;
-		ep.AddCount = 0.0f;
-		ep.AddSpeed = 0.0f;
-		AddParticle(ep);
-	}
-}
-
-void TrainView::
-Explosion6(Particle* par)
-{
-	Particle ep;
-	for (int i = 0; i < 100; i++) {
-		ep.b = float(rand() % 100) / 60.0f;
-		ep.g = float(rand() % 100) / 60.0f;
-		ep.r = float(rand() % 100) / 60.0f;
-		ep.life = 0.8f;
-		ep.fade = 0.01f + float(rand() % 31) / 10000.0f;
-		ep.size = 0.8f;
-		ep.xpos = par->xpos;
-		ep.ypos = par->ypos;
-		ep.zpos = par->zpos;
-		ep.xspeed = 0.01f - float(rand() % 21) / 1000.0f;
-		ep.yspeed = 0.01f - float(rand() % 21) / 1000.0f;
-		ep.zspeed = 0.01f - float(rand() % 21) / 1000.0f;
-		ep.bFire = 0;
-		ep.nExpl = 7;
-		ep.bAddParts = 0;
-		ep.AddCount = 0.0f;
-		ep.AddSpeed = 0.0f;
-		AddParticle(ep);
-	}
-}
-
-void TrainView::
-Explosion7(Particle* par)
-{
-	Particle ep;
-	for (int i = 0; i < 10; i++) {
-		ep.b = par->b;
-		ep.g = par->g;
-		ep.r = par->r;
-		ep.life = 0.5f;
-		ep.fade = 0.01f + float(rand() % 31) / 10000.0f;
-		ep.size = 0.6f;
-		ep.xpos = par->xpos;
-		ep.ypos = par->ypos;
-		ep.zpos = par->zpos;
-		ep.xspeed = 0.02f - float(rand() % 41) / 1000.0f;
-		ep.yspeed = 0.02f - float(rand() % 41) / 1000.0f;
-		ep.zspeed = 0.02f - float(rand() % 41) / 1000.0f;
-		ep.bFire = 0;
-		ep.nExpl = 0;
-		ep.bAddParts = 0;
-		ep.AddCount = 0.0f;
-		ep.AddSpeed = 0.0f;
-		AddParticle(ep);
-	}
-}
-
 void TrainView::
 ProcessParticles()
 {
-	Tick1 = Tick2;
-	Tick2 = GetTickCount();
-	DTick = float(Tick2 - Tick1);
-	DTick *= 0.5f;
-	Particle ep;
-	if (nOfFires < MAX_FIRES)
-	{
-		InitParticle(ep);
-	}
-	pParticle par = particles;
-
-	while (par) {
-		par->life -= par->fade * (float(DTick) * 0.1f);//Particle壽命衰減 
-		if (par->life <= 0.05f) 
-		{//當壽命小於一定值
-
-			if (par->nExpl) 
-			{//爆炸效果
-				switch (par->nExpl) 
-				{
-				case 1:
-					Explosion1(par);
-					break;
-				case 2:
-					Explosion2(par);
-					break;
-				case 3:
-					Explosion3(par);
-					break;
-				case 4:
-					Explosion4(par);
-					break;
-				case 5:
-					Explosion5(par);
-					break;
-				case 6:
-					Explosion6(par);
-					break;
-				case 7:
-					Explosion7(par);
-					break;
-				default:
-					break;
-				}
-			}
-			if (par->bFire)
-				nOfFires--;
-			DeleteParticle(&par);
-		}
-		else 
-		{
-			par->xpos += par->xspeed * DTick;   
-			par->ypos += par->yspeed * DTick;
-			par->zpos += par->zspeed * DTick;   
-			par->yspeed -= grav * DTick;
-			if (par->bAddParts) {//假如有尾巴
-				par->AddCount += 0.01f * DTick;//AddCount變化愈慢，尾巴粒子愈小  
-				if (par->AddCount > par->AddSpeed) {//AddSpeed愈大，尾巴粒子愈小  
-					par->AddCount = 0;
-					ep.b = par->b;  ep.g = par->g;  ep.r = par->r;
-					ep.life = par->life - 0.01f;//壽命變短  
-					ep.fade = par->fade * 7.0f;//衰减快一些  
-					ep.size = 0.6f;//粒子尺寸小一些  
-					ep.xpos = par->xpos;  ep.ypos = par->ypos;  ep.zpos = par->zpos;
-					ep.xspeed = 0.0f;    ep.yspeed = 0.0f;  ep.zspeed = 0.0f;
-					ep.bFire = 0;
-					ep.nExpl = 0;
-					ep.bAddParts = 0;//尾巴粒子没有尾巴  
-					ep.AddCount = 0.0f;
-					ep.AddSpeed = 0.0f;
-					AddParticle(ep);
-				}
-			}   par = par->pNext;//更新下一粒子    
-		}  
-	}
+	// the steps started after the particles were drawn last frame
+	fireworks.finish();
 }
 
+//************************************************************************
+//
+// * all the sparks in one instanced draw, see ParticleRenderer
+//========================================================================
 void TrainView::
 DrawParticles()
+//========================================================================
 {
-	glBindTexture(GL_TEXTURE_2D, textureID);
+	// the fireworks go off behind the park. The translation is left on the
+	// modelview stack as it always was - drawTiles is placed after it
 	glTranslatef(0, 0, -60);
-	pParticle par;
-	par = particles;
-	while (par)
-	{
-		glColor4f(par->r, par->g, par->b, par->life);
-		glBegin(GL_TRIANGLE_STRIP);
-		glTexCoord2d(1, 1);
-		glVertex3f(par->xpos + par->size, par->ypos + par->size, par->zpos);
-		glTexCoord2d(0, 1);
-		glVertex3f(par->xpos - par->size, par->ypos + par->size, par->zpos);
-		glTexCoord2d(1, 0);
-		glVertex3f(par->xpos + par->size, par->ypos - par->size, par->zpos);
-		glTexCoord2d(0, 0);
-		glVertex3f(par->xpos - par->size, par->ypos - par->size, par->zpos);
-		glEnd();
-		par = par->pNext;
-	}
+	fireworksRenderer.draw(fireworks, fireworksShader);
 }
 
 void TrainView::
@@ -1791,7 +1123,9 @@ initPlaneShader()
 {
 	this->planeShader = new Shader{ PROJECT_DIR "/src/shaders/simple.vert",
 										nullptr, nullptr, nullptr,
-										PROJECT_DIR "/src/shaders/simple.frag" };
+										PROJECT_DIR "/src/shaders/simple.frag",
+										PROJECT_DIR "/src/shaders/shadow.frag" };
+	this->planeDraw.create(*this->planeShader, "per_draw", 2);
 
 	GLfloat vertices[] = {
 		//down
@@ -1867,28 +1201,16 @@ drawPlane()
 	model_matrix = glm::translate(model_matrix, this->source_pos);
 	model_matrix = glm::scale(model_matrix, glm::vec3(200.0f, 200.0f, 200.0f));
 
-	glm::mat4 view_matrix;
-	glm::mat4 projection_matrix;
-
-	glGetFloatv(GL_MODELVIEW_MATRIX, &view_matrix[0][0]);
-	glGetFloatv(GL_PROJECTION_MATRIX, &projection_matrix[0][0]);
-
-	glUniformMatrix4fv(glGetUniformLocation(this->planeShader->Program, "u_view"), 1, GL_FALSE, &view_matrix[0][0]);
-	glUniformMatrix4fv(glGetUniformLocation(this->planeShader->Program, "u_projection"), 1, GL_FALSE, &projection_matrix[0][0]);
-
-	glUniformMatrix4fv(
-		glGetUniformLocation(this->planeShader->Program, "u_model"), 1, GL_FALSE, &model_matrix[0][0]);
-	glUniform3fv(
-		glGetUniformLocation(this->planeShader->Program, "u_color"),
-		1,
-		&glm::vec3(0.0f, 1.0f, 0.0f)[0]);
+	// the view and projection come from commom_matrices (see setUBO)
+	this->planeDraw.set("u_model", &model_matrix[0][0], sizeof(model_matrix));
+	this->planeDraw.bind();
 
 	//this->planeTexture->bind(0);
 	//glUniform1i(glGetUniformLocation(this->planeShader->Program, "u_texture"), 0);
 	//glUniform4fv(glGetUniformLocation(this->planeShader->Program, "plane"), 1, &plane[0]);
 
 	this->planeTexture->bind(0);
-	glUniform1i(glGetUniformLocation(this->planeShader->Program, "u_texture"), 0);
+	this->planeShader->setInt("u_texture", 0);
 
 	//bind VAO
 	glBindVertexArray(this->plane->vao);
@@ -1907,105 +1229,35 @@ initHeightMapShader()
 {
 	this->heightMapShader = new Shader{ PROJECT_DIR "/src/shaders/heightMap.vert",
 										nullptr, nullptr, nullptr,
-										PROJECT_DIR "/src/shaders/heightMap.frag" };
-
-	float size = 0.01f;
-	unsigned int width = 2.0f / size;
-	unsigned int height = 2.0f / size;
-
-	GLfloat* vertices = new GLfloat[width * height * 4 * 3]();
-	GLfloat* normal = new GLfloat[width * height * 4 * 3]();
-	GLfloat* texture_coordinate = new GLfloat[width * height * 4 * 2]();
-	GLuint* element = new GLuint[width * height * 6]();
-
-	for (int i = 0; i < width * height * 4 * 3; i += 12)
-	{
-		unsigned int h = i / 12 / width;
-		unsigned int w = i / 12 % width;
-
-		vertices[i] = w * size - 1.0f + size;
-		vertices[i + 1] = 0.6f;
-		vertices[i + 2] = h * size - 1.0f + size;
-
-		vertices[i + 3] = vertices[i] - size;
-		vertices[i + 4] = 0.6f;
-		vertices[i + 5] = vertices[i + 2];
-
-		vertices[i + 6] = vertices[i + 3];
-		vertices[i + 7] = 0.6f;
-		vertices[i + 8] = vertices[i + 5] - size;
-
-		vertices[i + 9] = vertices[i];
-		vertices[i + 10] = 0.6f;
-		vertices[i + 11] = vertices[i + 8];
-	}
-
-	for (int i = 0; i < width * height * 4 * 3; i += 3)
-	{
-		normal[i] = 0.0f;
-		normal[i + 1] = 1.0f;
-		normal[i + 2] = 0.0f;
-	}
-
-	for (int i = 0, j = 0; i < width * height * 4 * 2; i += 8, ++j)
-	{
-		int ii = i / (4 * 2), jj = i / (height * +4 * 2);
-		texture_coordinate[i] = 0.005 + ii * 0.005;
-		texture_coordinate[i + 1] = 0.005 + jj * 0.005;
-
-		texture_coordinate[i + 2] = 0.0f + ii * 0.005;
-		texture_coordinate[i + 3] = 0.005 + jj * 0.005;
-
-		texture_coordinate[i + 4] = 0.0f + ii * 0.005;
-		texture_coordinate[i + 5] = 0.0f + jj * 0.005;
+										PROJECT_DIR "/src/shaders/heightMap.frag",
+										PROJECT_DIR "/src/shaders/shadow.frag" };
+	this->heightMapDraw.create(*this->heightMapShader, "per_draw", 2);
 
-		texture_coordinate[i + 6] = 0.005 + ii * 0.005;
-		texture_coordinate[i + 7] = 0.0f + jj * 0.005;
-	}
+	// 200 x 200 squares over [-1, 1], sharing their corners
+	this->heightMapGrid.create(200, 0.6f, this->waterGridFromVertexID);
 
-	for (int i = 0, j = 0; i < width * height * 6; i += 6, j += 4)
-	{
-		element[i] = j + 1;
-		element[i + 1] = j;
-		element[i + 2] = j + 3;
+	this->rippleShader = new Shader(PROJECT_DIR "/src/shaders/ripple.vert",
+		nullptr, nullptr, nullptr,
+		PROJECT_DIR "/src/shaders/ripple.frag");
+	this->ripples.create(256);
 
-		element[i + 3] = element[i + 2];
-		element[i + 4] = j + 2;
-		element[i + 5] = element[i];
+	// the surface the mouse picks: the heights heightMap.vert gives the
+	// grid corners with the first frame of the waves, without the ripples
+	const unsigned int corners = 201;
+	std::vector<float> heights(corners * corners, 0.6f);
+	int width, height, nrComponents;
+	unsigned char* data = stbi_load("Images/waves5/000.png", &width, &height, &nrComponents, 3);
+	if (data) {
+		for (unsigned int z = 0; z < corners; ++z)
+			for (unsigned int x = 0; x < corners; ++x) {
+				int px = (int)(x * (width - 1) / (corners - 1));
+				int py = (int)(z * (height - 1) / (corners - 1));
+				float r = data[(py * width + px) * 3] / 255.0f;
+				heights[z * corners + x] += r * 0.1f * this->waveAmplitude * 5.0f;
+			}
+		stbi_image_free(data);
 	}
-
-	this->heightMap = new VAO;
-	this->heightMap->element_amount = width * height * 6;
-	glGenVertexArrays(1, &this->heightMap->vao);
-	glGenBuffers(3, this->heightMap->vbo);
-	glGenBuffers(1, &this->heightMap->ebo);
-
-	glBindVertexArray(this->heightMap->vao);
-
-	// Position attribute
-	glBindBuffer(GL_ARRAY_BUFFER, this->heightMap->vbo[0]);
-	glBufferData(GL_ARRAY_BUFFER, width * height * 4 * 3 * sizeof(GLfloat), vertices, GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-	glEnableVertexAttribArray(0);
-
-	// Normal attribute
-	glBindBuffer(GL_ARRAY_BUFFER, this->heightMap->vbo[1]);
-	glBufferData(GL_ARRAY_BUFFER, width * height * 4 * 3 * sizeof(GLfloat), normal, GL_STATIC_DRAW);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-	glEnableVertexAttribArray(1);
-
-	// Texture Coordinate attribute
-	glBindBuffer(GL_ARRAY_BUFFER, this->heightMap->vbo[2]);
-	glBufferData(GL_ARRAY_BUFFER, width * height * 4 * 2 * sizeof(GLfloat), texture_coordinate, GL_STATIC_DRAW);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (GLvoid*)0);
-	glEnableVertexAttribArray(2);
-
-	//Element attribute
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->heightMap->ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, width * height * 6 * sizeof(GLuint), element, GL_STATIC_DRAW);
-
-	// Unbind VAO
-	glBindVertexArray(0);
+	this->waterSurface.set(corners, heights.data());
 
 	for (int i = 0; i < 200; ++i)
 	{
@@ -2024,6 +1276,10 @@ initHeightMapShader()
 void TrainView::
 drawHeightMapWave()
 {
+	// the waves catch up with the clock before they are drawn
+	this->ripples.step(this->waterSteps, this->rippleShader);
+	this->waterSteps = 0;
+
 	glEnable(GL_BLEND);
 
 	this->heightMapShader->Use();
@@ -2033,59 +1289,40 @@ drawHeightMapWave()
 	model_matrix = glm::translate(model_matrix, pos);
 	model_matrix = glm::scale(model_matrix, scal);
 
-	glUniformMatrix4fv(
-		glGetUniformLocation(this->heightMapShader->Program, "u_model"), 1, GL_FALSE, &model_matrix[0][0]);
-	glUniform3fv(
-		glGetUniformLocation(this->heightMapShader->Program, "u_color"),
-		1,
-		&glm::vec3(0.0f, 1.0f, 0.0f)[0]);
+	this->heightMapDraw.set("u_model", &model_matrix[0][0], sizeof(model_matrix));
+	this->heightMapDraw.bind();
 
 	heightMapTexture[heightMapIndex].bind(0);
-	glUniform1i(glGetUniformLocation(this->heightMapShader->Program, "u_texture"), 0);
+	this->heightMapShader->setInt("u_texture", 0);
 	this->planeTexture->bind(1);
-	glUniform1i(glGetUniformLocation(this->heightMapShader->Program, "tiles"), 1);
+	this->heightMapShader->setInt("tiles", 1);
 
-	//glUniform1f(glGetUniformLocation(this->heightMapShader->Program, "amplitude"), tw->amplitude->value());
+	this->heightMapShader->setFloat("amplitude", this->waveAmplitude);
 
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_CUBE_MAP, this->cubemapTexture);
-	glUniform1i(glGetUniformLocation(this->heightMapShader->Program, "skyBox"), 0);
+	this->heightMapShader->setInt("skyBox", 0);
 
-	glUniform1f(glGetUniformLocation(this->heightMapShader->Program, "time"), t_time);
+	this->heightMapShader->setFloat("time", (float)tw->simClock.time());
 
-	GLfloat* view_matrix = new GLfloat[16]();
+	GLfloat view_matrix[16];
 
 	glGetFloatv(GL_MODELVIEW_MATRIX, view_matrix);
 
-	view_matrix = inverse(view_matrix);
-
-	this->cameraPosition = glm::vec3(view_matrix[12], view_matrix[13], view_matrix[14]);
-	glUniform3fv(glGetUniformLocation(this->heightMapShader->Program, "camera"), 1, &cameraPosition[0]);
-
-	//bind VAO
-	glBindVertexArray(this->heightMap->vao);
-
-	glDrawElements(GL_TRIANGLES, this->heightMap->element_amount, GL_UNSIGNED_INT, 0);
-
-	for (int i = 0; i < allDrop.size(); ++i)
-	{
-		if (t_time - allDrop[i].time > allDrop[i].keepTime)
-		{
-			allDrop.erase(allDrop.begin() + i);
-			--i;
-			continue;
-		}
-
-		glUniform2f(glGetUniformLocation(this->heightMapShader->Program, "dropPoint"), allDrop[i].point.x, allDrop[i].point.y);
-		std::cout << allDrop[i].point.x << " " << allDrop[i].point.y << std::endl;
-		glUniform1f(glGetUniformLocation(this->heightMapShader->Program, "dropTime"), allDrop[i].time);
-		glUniform1f(glGetUniformLocation(this->heightMapShader->Program, "interactiveRadius"), allDrop[i].radius);
+	GLfloat* inverse_view = inverse(view_matrix);
 
-		glDrawElements(GL_TRIANGLES, this->heightMap->element_amount, GL_UNSIGNED_INT, 0);
+	if (inverse_view) {
+		this->cameraPosition = glm::vec3(inverse_view[12], inverse_view[13], inverse_view[14]);
+		delete[] inverse_view;
 	}
+	this->heightMapShader->setVec3("camera", &cameraPosition[0]);
 
-	//unbind VAO
-	glBindVertexArray(0);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, this->ripples.texture());
+	this->heightMapShader->setInt("u_ripples", 2);
+	glActiveTexture(GL_TEXTURE0);
+
+	this->heightMapGrid.draw(this->heightMapShader);
 
 	//unbind shader(switch to fixed pipeline)
 	glUseProgram(0);
@@ -2093,45 +1330,41 @@ drawHeightMapWave()
 	glDisable(GL_BLEND);
 }
 
+//************************************************************************
+//
+// * Drop on the water where the mouse is. The mouse ray is taken into
+//   the space of the water grid and shot at waterSurface on the CPU, so
+//   nothing has to be drawn and read back
+//========================================================================
 void TrainView::
-addDrop(float radius, float keepTime)
+addDrop(float radius, float strength)
+//========================================================================
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, interactiveFrameBuffer);
-	glBindTexture(GL_TEXTURE_2D, interactiveTextureBuffer);
-	glBindRenderbuffer(GL_RENDERBUFFER, interactiveRenderBuffer);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-
-	interactiveFrameShader->Use();
-
-	glm::mat4 view_matrix;
-	glm::mat4 projection_matrix;
-
-	glGetFloatv(GL_MODELVIEW_MATRIX, &view_matrix[0][0]);
-	glGetFloatv(GL_PROJECTION_MATRIX, &projection_matrix[0][0]);
-
-	glUniformMatrix4fv(glGetUniformLocation(this->interactiveFrameShader->Program, "view"), 1, GL_FALSE, &view_matrix[0][0]);
-	glUniformMatrix4fv(glGetUniformLocation(this->interactiveFrameShader->Program, "projection"), 1, GL_FALSE, &projection_matrix[0][0]);
-
-	glm::mat4 model_matrix = glm::mat4(1.0f);
-	model_matrix = glm::translate(model_matrix, glm::vec3(0.0f, 0.0f, 0.0f));
-	model_matrix = glm::scale(model_matrix, glm::vec3(100.0f, 100.0f, 100.0f));
+	if (this->waterSurface.isEmpty())
+		return;
 
-	glUniformMatrix4fv(
-		glGetUniformLocation(this->interactiveFrameShader->Program, "u_model"), 1, GL_FALSE, &model_matrix[0][0]);
+	make_current();
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	setProjection();
 
-	glBindVertexArray(this->heightMap->vao);
-	glDrawElements(GL_TRIANGLES, this->heightMap->element_amount, GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+	double r1x, r1y, r1z, r2x, r2y, r2z;
+	getMouseLine(r1x, r1y, r1z, r2x, r2y, r2z);
 
-	glReadBuffer(GL_COLOR_ATTACHMENT0);
-	glm::vec3 uv;
-	glReadPixels(Fl::event_x(), h() - Fl::event_y(), 1, 1, GL_RGB, GL_FLOAT, &uv[0]);
+	// the water is drawn with translate(pos) * scale(scal)
+	const float origin[3] = { ((float)r1x - pos.x) / scal.x,
+							  ((float)r1y - pos.y) / scal.y,
+							  ((float)r1z - pos.z) / scal.z };
+	const float dir[3] = { (float)(r2x - r1x) / scal.x,
+						   (float)(r2y - r1y) / scal.y,
+						   (float)(r2z - r1z) / scal.z };
 
-	glReadBuffer(GL_NONE);
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	float t;
+	if (!this->waterSurface.intersect(origin, dir, 1e30f, t))
+		return;
 
-	if (uv.b != 1.0f)
-		allDrop.push_back(Drop(glm::vec2(uv.x, uv.y), this->t_time, radius, keepTime));
+	glm::vec2 uv((origin[0] + t * dir[0] + 1.0f) * 0.5f, (origin[2] + t * dir[2] + 1.0f) * 0.5f);
+	ripples.addDrop(Drop(uv, radius, strength));
 }
 
 GLfloat* TrainView::
@@ -2256,8 +1489,10 @@ inverse(GLfloat* m)
 
 	det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
 
-	if (det == 0)
-		return false;
+	if (det == 0) {
+		delete[] inv;
+		return nullptr;
+	}
 
 	det = 1.0 / det;
 
@@ -2267,12 +1502,41 @@ inverse(GLfloat* m)
 	return inv;
 }
 
+//************************************************************************
+//
+// * shader for drawing many copies of a mesh, one transform per instance
+//========================================================================
+void TrainView::
+initInstancedShader()
+//========================================================================
+{
+	this->instancedShader = new Shader(PROJECT_DIR "/src/shaders/instanced.vert",
+		nullptr, nullptr, nullptr,
+		PROJECT_DIR "/src/shaders/instanced.frag",
+		PROJECT_DIR "/src/shaders/shadow.frag");
+}
+
+//************************************************************************
+//
+// * camera facing sprites for the fireworks
+//========================================================================
+void TrainView::
+initFireworksShader()
+//========================================================================
+{
+	this->fireworksShader = new Shader(PROJECT_DIR "/src/shaders/Particle.vert",
+		nullptr, nullptr, nullptr,
+		PROJECT_DIR "/src/shaders/Particle.frag");
+}
+
 void TrainView::
 initTilesShader()
 {
 	this->tilesShader = new Shader(PROJECT_DIR "/src/shaders/tiles.vert",
 		nullptr, nullptr, nullptr,
-		PROJECT_DIR "/src/shaders/tiles.frag");
+		PROJECT_DIR "/src/shaders/tiles.frag",
+		PROJECT_DIR "/src/shaders/shadow.frag");
+	this->tilesDraw.create(*this->tilesShader, "per_draw", 2);
 
 	GLfloat  vertices[] = {
 		// back
@@ -2447,23 +1711,12 @@ drawTiles()
 	//if (reflection)
 	//	model_matrix = glm::scale(model_matrix, glm::vec3(1, 1, 1));
 
-	glm::mat4 view_matrix;
-	glm::mat4 projection_matrix;
-
-	glGetFloatv(GL_MODELVIEW_MATRIX, &view_matrix[0][0]);
-	glGetFloatv(GL_PROJECTION_MATRIX, &projection_matrix[0][0]);
-
-	glUniformMatrix4fv(glGetUniformLocation(this->tilesShader->Program, "view"), 1, GL_FALSE, &view_matrix[0][0]);
-	glUniformMatrix4fv(glGetUniformLocation(this->tilesShader->Program, "projection"), 1, GL_FALSE, &projection_matrix[0][0]);
+	// the view and projection come from commom_matrices (see setUBO)
+	this->tilesDraw.set("u_model", &model_matrix[0][0], sizeof(model_matrix));
+	this->tilesDraw.bind();
 
-	glUniformMatrix4fv(
-		glGetUniformLocation(this->tilesShader->Program, "u_model"), 1, GL_FALSE, &model_matrix[0][0]);
-	glUniform3fv(
-		glGetUniformLocation(this->tilesShader->Program, "u_color"),
-		1,
-		&glm::vec3(0.0f, 1.0f, 0.0f)[0]);
 	this->tilesTexture->bind(0);
-	glUniform1i(glGetUniformLocation(this->tilesShader->Program, "u_texture"), 0);
+	this->tilesShader->setInt("u_texture", 0);
 	//glUniform4fv(glGetUniformLocation(this->tilesShader->Program, "plane"), 1, &plane[0]);
 
 	//bind VAO
@@ -2478,37 +1731,97 @@ drawTiles()
 	glUseProgram(0);
 }
 
+//************************************************************************
+//
+// * the shader, and the parts of the Gundam in one arena (from their
+//   .mesh files, made from the .obj the first time). The parts stay
+//   loaded when the context goes; only the GL objects are made again
+//========================================================================
 void TrainView::
-load2Buffer(char* obj, int i) {
-	std::vector<glm::vec3> vertices;
-	std::vector<glm::vec2> uvs;
-	std::vector<glm::vec3> normals; // Won't be used at the moment.
-	std::vector<unsigned int> materialIndices;
-
-	bool res = loadOBJ(obj, vertices, uvs, normals, faces[i], mtls[i]);
-	if (!res) printf("load failed\n");
+initGundams()
+//========================================================================
+{
+	this->modelShader = new Shader(PROJECT_DIR "/src/shaders/model.vert",
+		nullptr, nullptr, nullptr,
+		PROJECT_DIR "/src/shaders/model.frag",
+		PROJECT_DIR "/src/shaders/shadow.frag");
 
-	//glUseProgram(program);
+	if (gundams.parts())
+		return;
 
-	glGenBuffers(1, &VBOs[i]);
-	glBindBuffer(GL_ARRAY_BUFFER, VBOs[i]);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
-	vertices_size[i] = vertices.size();
+	// in the order drawGundams numbers them
+	static const char* parts[PARTSNUM] = {
+		PROJECT_DIR "/src/Obj/body.obj",
+		PROJECT_DIR "/src/Obj/ulefthand.obj",
+		PROJECT_DIR "/src/Obj/dlefthand.obj",
+		PROJECT_DIR "/src/Obj/lefthand.obj",
+		PROJECT_DIR "/src/Obj/lshouder.obj",
+		PROJECT_DIR "/src/Obj/head.obj",
+		PROJECT_DIR "/src/Obj/urighthand.obj",
+		PROJECT_DIR "/src/Obj/drighthand.obj",
+		PROJECT_DIR "/src/Obj/righthand.obj",
+		PROJECT_DIR "/src/Obj/rshouder.obj",
+		PROJECT_DIR "/src/Obj/back2.obj",
+		PROJECT_DIR "/src/Obj/dbody.obj",
+		PROJECT_DIR "/src/Obj/uleftleg.obj",
+		PROJECT_DIR "/src/Obj/dleftleg.obj",
+		PROJECT_DIR "/src/Obj/leftfoot.obj",
+		PROJECT_DIR "/src/Obj/urightleg.obj",
+		PROJECT_DIR "/src/Obj/drightleg.obj",
+		PROJECT_DIR "/src/Obj/rightfoot.obj",
+	};
+	gundams.loadMaterials(PROJECT_DIR "/src/Obj/gundam.mtl");
+	for (int i = 0; i < PARTSNUM; ++i)
+		if (gundams.addPart(parts[i]) != i) {
+			printf("load failed\n");
+			return;
+		}
+	gundams.setCapacity(GUNDAMS);
+}
 
-	//(buffer type,data起始位置,data size,data first ptr)
-	//vertices_size[i] = glm_model->numtriangles;
+//************************************************************************
+//
+// * one Gundam, standing still by the park: every part is moved from
+//   where its .obj has it (about the origin) to its place on the body
+//========================================================================
+void TrainView::
+drawGundams(bool doingShadows)
+//========================================================================
+{
+	if (gundams.parts() != PARTSNUM)
+		return;
 
-	//printf("vertices:%d\n",vertices_size[);
+	// in the order initGundams loads them, the body's middle at 0
+	static const float place[PARTSNUM][3] = {
+		{ 0.0f, 0.0f, 0.0f },		// body
+		{ 3.7f, 1.0f, -0.5f },		// upper left arm
+		{ 3.7f, -2.0f, -0.5f },		// lower left arm
+		{ 3.7f, -6.8f, -0.7f },		// left hand
+		{ 3.7f, 1.0f, -0.5f },		// left shoulder
+		{ 0.0f, 3.9f, -0.5f },		// head
+		{ -3.9f, 1.7f, -0.2f },		// upper right arm
+		{ -3.9f, -1.3f, -0.2f },	// lower right arm
+		{ -3.9f, -7.3f, -0.3f },	// right hand
+		{ -3.9f, 1.1f, -0.2f },		// right shoulder
+		{ 0.0f, 2.0f, -4.5f },		// back
+		{ 0.0f, -5.3f, 0.0f },		// waist
+		{ 1.8f, -4.5f, 0.0f },		// upper left leg
+		{ 1.8f, -8.5f, 0.0f },		// lower left leg
+		{ 1.8f, -13.5f, 0.0f },		// left foot
+		{ -1.8f, -4.5f, 0.0f },		// upper right leg
+		{ -1.8f, -8.5f, 0.0f },		// lower right leg
+		{ -1.8f, -13.5f, 0.0f },	// right foot
+	};
 
-	glGenBuffers(1, &uVBOs[i]);
-	glBindBuffer(GL_ARRAY_BUFFER, uVBOs[i]);
-	glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(glm::vec2), &uvs[0], GL_STATIC_DRAW);
-	uvs_size[i] = uvs.size();
+	// feet on the ground, turned toward the middle of the park
+	const glm::mat4 body = glm::translate(glm::vec3(60.0f, 16.0f, -60.0f))
+		* glm::rotate(glm::radians(-45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	for (int p = 0; p < PARTSNUM; ++p) {
+		glm::mat4 m = body * glm::translate(glm::vec3(place[p][0], place[p][1], place[p][2]));
+		gundams.setTransform(0, p, &m[0][0]);
+	}
 
-	glGenBuffers(1, &nVBOs[i]);
-	glBindBuffer(GL_ARRAY_BUFFER, nVBOs[i]);
-	glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(glm::vec3), &normals[0], GL_STATIC_DRAW);
-	normals_size[i] = normals.size();
+	gundams.draw(GUNDAMS, modelShader, doingShadows);
 }
 
 //bool TrainView::
@@ -159,6 +159,35 @@ TrainWindow(const int x, const int y)
 
 		pty += 110;
 
+		profileButton = new Fl_Button(605, pty, 60, 20, "Profile");
+		togglify(profileButton);
+		Fl_Button* csv = new Fl_Button(670, pty, 80, 20, "Save Times");
+		csv->callback((Fl_Callback*)profileCB, this);
+
+		pty += 25;
+
+		pauseButton = new Fl_Button(605, pty, 60, 20, "Pause");
+		togglify(pauseButton);
+		Fl_Button* stepb = new Fl_Button(670, pty, 60, 20, "Step");
+		stepb->callback((Fl_Callback*)stepCB, this);
+
+		pty += 25;
+		timeScale = new Fl_Value_Slider(655, pty, 140, 20, "time");
+		timeScale->range(0.1, 4);
+		timeScale->value(1);
+		timeScale->align(FL_ALIGN_LEFT);
+		timeScale->type(FL_HORIZONTAL);
+
+		pty += 25;
+		simRate = new Fl_Value_Slider(655, pty, 140, 20, "steps/s");
+		simRate->range(10, 240);
+		simRate->step(1);
+		simRate->value(60);
+		simRate->align(FL_ALIGN_LEFT);
+		simRate->type(FL_HORIZONTAL);
+
+		pty += 25;
+
 		// TODO: add widgets for all of your fancier features here
 #ifdef EXAMPLE_SOLUTION
 		makeExampleWidgets(this,pty);
@@ -205,13 +234,18 @@ damageMe()
 
 //************************************************************************
 //
-// * This will get called (approximately) 30 times per second
-//   if the run button is pressed
+// * This gets called once per step of the clock if the run button is
+//   pressed, with dir scaled so the train goes as far in a second as it
+//   did at 30 steps a second
 //========================================================================
 void TrainWindow::
 advanceTrain(float dir)
 //========================================================================
 {
+	// where the train was, to draw in between
+	trainView->last_t_time = trainView->t_time;
+	trainView->last_f_time = trainView->f_time;
+
 	//#####################################################################
 	// TODO: make this work for your train
 	//#####################################################################
@@ -231,27 +265,23 @@ advanceTrain(float dir)
 	if (world.trainU < 0) world.trainU += nct;
 #endif
 	
-	trainView->t_time += (dir / m_Track.points.size() / (trainView->DIVIDE_LINE / 40));
-	if (trainView->t_time > 1.0f)
-		trainView->t_time -= 1.0f;
+	if (arcLength->value()) {
+		// move a fixed distance along the track, whatever the spacing of
+		// the control points: 3 units per tick for every unit of speed
+		trainView->updateArcLength();
+		ArcLengthTable& table = trainView->arcLengthTable;
+		trainView->s_time = table.lengthAt(trainView->t_time) + dir * (float)speed->value() * 3.0f;
+		trainView->t_time = table.paramAt(trainView->s_time);
+	} else {
+		trainView->t_time += (dir / m_Track.points.size() / (trainView->DIVIDE_LINE / 40));
+		if (trainView->t_time > 1.0f)
+			trainView->t_time -= 1.0f;
+		if (trainView->t_time < 0.0f)
+			trainView->t_time += 1.0f;
+	}
 
 	trainView->f_time += (dir / m_Track.points.size() / (trainView->DIVIDE_LINE / 40));
 	if (trainView->f_time > 1.0f)
 		trainView->f_time -= 1.0f;
 
-	/*if (arcLength->value())
-	{
-		trainView->s_time += (dir / trainView->totalDistance);
-		
-		if (trainView->s_time > trainView->totalDistance)
-			trainView->s_time -= trainView->totalDistance;
-
-		trainView->t_time = (float)trainView->s_time * 50 / trainView->totalDistance;
-
-		if (trainView->totalDistance == 0)
-		{
-			trainView->s_time = 0.0f;
-			trainView->t_time = 0.0f;
-		}
-	}*/
 }                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                  
\ No newline at end of file
@@ -0,0 +1,125 @@
+/************************************************************************
+     File:        WaterGrid.cpp
+
+     Comment:     The grid the water is drawn on. See WaterGrid.H
+
+*************************************************************************/
+
+#include "WaterGrid.H"
+#include "MeshOptimize.H"
+#include "RenderUtilities/Shader.h"
+
+//****************************************************************************
+//
+// * Constructor
+//============================================================================
+WaterGrid::
+WaterGrid()
+	: vao(0), vbo(0), ebo(0), indexCount(0), n(0), y(0)
+//============================================================================
+{
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void WaterGrid::
+create(unsigned int cells, float height, bool fromVertexID)
+//============================================================================
+{
+	release();
+	n = cells;
+	y = height;
+
+	// core profile draws need a VAO even with nothing in it
+	glGenVertexArrays(1, &vao);
+	if (fromVertexID || !n)
+		return;
+
+	MeshData mesh;
+	const unsigned int side = n + 1;
+	mesh.vertices.reserve((size_t)side * side * MESH_VERTEX_FLOATS);
+	for (unsigned int row = 0; row < side; ++row)
+		for (unsigned int column = 0; column < side; ++column) {
+			float u = (float)column / n, v = (float)row / n;
+			const float vertex[MESH_VERTEX_FLOATS] = { u * 2 - 1, y, v * 2 - 1, u, v, 0, 1, 0 };
+			mesh.vertices.insert(mesh.vertices.end(), vertex, vertex + MESH_VERTEX_FLOATS);
+		}
+
+	// each square split from b to c, as HeightField::hitSquare and the
+	// strips of the vertex ID path split it
+	mesh.indices.reserve((size_t)n * n * 6);
+	for (unsigned int row = 0; row < n; ++row)
+		for (unsigned int column = 0; column < n; ++column) {
+			unsigned int a = row * side + column, b = a + 1, c = a + side, d = c + 1;
+			const unsigned int square[6] = { c, d, b, b, a, c };
+			mesh.indices.insert(mesh.indices.end(), square, square + 6);
+		}
+
+	MeshRange all = { "", 0, (unsigned int)mesh.indices.size() };
+	mesh.ranges.push_back(all);
+	optimizeMesh(mesh);
+	indexCount = (GLsizei)mesh.indices.size();
+
+	glGenBuffers(1, &vbo);
+	glGenBuffers(1, &ebo);
+	glBindVertexArray(vao);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(float), mesh.vertices.data(), GL_STATIC_DRAW);
+	const GLsizei stride = MESH_VERTEX_FLOATS * sizeof(float);
+	// position 0, normal 1, uv 2, as the water shaders have them
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(5 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(2);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(unsigned int), mesh.indices.data(), GL_STATIC_DRAW);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void WaterGrid::
+draw(Shader* shader) const
+//============================================================================
+{
+	if (!vao || !n)
+		return;
+
+	shader->setInt("u_grid_cells", vbo ? 0 : (int)n);
+	shader->setFloat("u_grid_height", y);
+
+	glBindVertexArray(vao);
+	if (vbo)
+		glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+	else
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 2 * (n + 1), n);
+	glBindVertexArray(0);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void WaterGrid::
+release()
+//============================================================================
+{
+	if (vao)
+		glDeleteVertexArrays(1, &vao);
+	if (vbo)
+		glDeleteBuffers(1, &vbo);
+	if (ebo)
+		glDeleteBuffers(1, &ebo);
+	vao = vbo = ebo = 0;
+	indexCount = 0;
+}
@@ -0,0 +1,156 @@
+/************************************************************************
+     File:        WaterRipples.cpp
+
+     Comment:     Ripples on the water, simulated on the GPU.
+						See WaterRipples.H
+
+*************************************************************************/
+
+#include <stddef.h>
+
+#include <algorithm>
+
+#include "WaterRipples.H"
+#include "RenderUtilities/Shader.h"
+
+//****************************************************************************
+//
+// * Constructor
+//============================================================================
+WaterRipples::
+WaterRipples()
+	: waveSpeed(0.25f), damping(0.995f), size(0), vao(0), current(0)
+//============================================================================
+{
+	textures[0] = textures[1] = 0;
+	fbos[0] = fbos[1] = 0;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void WaterRipples::
+create(unsigned int n)
+//============================================================================
+{
+	release();
+	size = n;
+
+	GLint oldFbo;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFbo);
+
+	glGenTextures(2, textures);
+	glGenFramebuffers(2, fbos);
+	for (int i = 0; i < 2; ++i) {
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, size, size, 0, GL_RG, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, fbos[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[i], 0);
+		glClearColor(0, 0, 0, 0);
+		glClear(GL_COLOR_BUFFER_BIT);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, oldFbo);
+
+	glGenVertexArrays(1, &vao);
+	current = 0;
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+bool WaterRipples::
+addDrop(const Drop& drop)
+//============================================================================
+{
+	if (pending.size() >= MAX_DROPS)
+		return false;
+	pending.push_back(drop);
+	return true;
+}
+
+//****************************************************************************
+//
+// * each step draws one triangle over the whole of the other texture
+//============================================================================
+void WaterRipples::
+step(unsigned int steps, Shader* shader)
+//============================================================================
+{
+	if (!fbos[0] || !shader || !steps)
+		return;
+	steps = std::min(steps, (unsigned int)MAX_RIPPLE_STEPS);
+
+	GLint oldFbo, viewport[4];
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFbo);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	GLboolean blend = glIsEnabled(GL_BLEND);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+
+	shader->Use();
+	shader->setInt("u_state", 0);
+	shader->setFloat("u_wave_speed", waveSpeed);
+	shader->setFloat("u_damping", damping);
+
+	// point xy, radius, strength
+	GLfloat drops[MAX_DROPS * 4];
+	for (size_t i = 0; i < pending.size(); ++i) {
+		drops[i * 4] = pending[i].point.x;
+		drops[i * 4 + 1] = pending[i].point.y;
+		drops[i * 4 + 2] = pending[i].radius;
+		drops[i * 4 + 3] = pending[i].strength;
+	}
+	if (!pending.empty())
+		shader->setVec4Array("u_drops", (GLsizei)pending.size(), drops);
+
+	glViewport(0, 0, size, size);
+	glBindVertexArray(vao);
+	glActiveTexture(GL_TEXTURE0);
+	for (unsigned int s = 0; s < steps; ++s) {
+		// the drops go in with the first step only
+		shader->setInt("u_drop_count", s ? 0 : (GLint)pending.size());
+		glBindFramebuffer(GL_FRAMEBUFFER, fbos[1 - current]);
+		glBindTexture(GL_TEXTURE_2D, textures[current]);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		current = 1 - current;
+	}
+	pending.clear();
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindVertexArray(0);
+	glUseProgram(0);
+	glBindFramebuffer(GL_FRAMEBUFFER, oldFbo);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	if (depthTest)
+		glEnable(GL_DEPTH_TEST);
+	if (blend)
+		glEnable(GL_BLEND);
+}
+
+//****************************************************************************
+//
+// *
+//============================================================================
+void WaterRipples::
+release()
+//============================================================================
+{
+	if (fbos[0])
+		glDeleteFramebuffers(2, fbos);
+	if (textures[0])
+		glDeleteTextures(2, textures);
+	if (vao)
+		glDeleteVertexArrays(1, &vao);
+	fbos[0] = fbos[1] = 0;
+	textures[0] = textures[1] = 0;
+	vao = 0;
+}
@@ -8,6 +8,7 @@ using namespace std;
 
 using namespace glm;
 #include "objloader.hpp"
+#include "ObjParser.H"
 
 // Very, VERY simple OBJ loader.
 // Here is a short list of features a real function would provide : 
@@ -30,94 +31,32 @@ bool loadOBJ(
 {
 	printf("Loading OBJ file %s...\n", path);
 
-	std::vector<unsigned int> vertexIndices, uvIndices, normalIndices,materialIndices;
-	std::vector<vec3> temp_vertices; 
-	std::vector<vec2> temp_uvs;
-	std::vector<vec3> temp_normals;
-	std::vector<string> temp_mtls;
-
-	FILE * file = fopen(path, "r");
-	if( file == NULL ){
-		printf("Impossible to open the .obj file ! Are you in the right path ? See Tutorial 1 for details\n");
+	// read with the fast parser (see ObjParser.H), which takes any face
+	// and leaves out what is missing
+	MeshData mesh;
+	if (!parseOBJ(path, mesh))
 		return false;
-	}
-	int fcount = 0;//face count for material
-	while( 1 ){
-
-		char lineHeader[128];
-		
-		// read the first word of the line
-		int res = fscanf(file, "%s", lineHeader);
-		if (res == EOF)
-			break; // EOF = End Of File. Quit the loop.
 
-		// else : parse lineHeader
-	
-		if ( strcmp( lineHeader, "v" ) == 0 ){//'v':OI
-			vec3 vertex;
-			fscanf(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z );
-			temp_vertices.push_back(vertex);
-		
-		}else if ( strcmp( lineHeader, "vt" ) == 0 ){
-			vec2 uv;
-			fscanf(file, "%f %f\n", &uv.x, &uv.y );
-			// Invert V coordinate since we will only use DDS texture,
-			//which are inverted.Remove if you want to use TGA or BMP loaders.
-			//uv.y = -uv.y; 
-			temp_uvs.push_back(uv);
-		}else if ( strcmp( lineHeader, "vn" ) == 0 ){
-			glm::vec3 normal;
-			fscanf(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z );
-			temp_normals.push_back(normal);
-		}else if ( strcmp( lineHeader, "f" ) == 0 ){
-		//	std::string vertex1, vertex2, vertex3;
-			unsigned int vertexIndex[3], uvIndex[3], normalIndex[3];
-			int matches = fscanf(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n", &vertexIndex[0], &uvIndex[0], &normalIndex[0],
-																	   &vertexIndex[1], &uvIndex[1], &normalIndex[1],
-																	   &vertexIndex[2], &uvIndex[2], &normalIndex[2] );
-			if (matches != 9){
-				printf("File can't be read by our simple parser :-( Try exporting with other options\n");
-				return false;
-			}
-			fcount++;
-			vertexIndices.push_back(vertexIndex[0]);
-			vertexIndices.push_back(vertexIndex[1]);
-			vertexIndices.push_back(vertexIndex[2]);
-			uvIndices    .push_back(uvIndex[0]);
-			uvIndices    .push_back(uvIndex[1]);
-			uvIndices    .push_back(uvIndex[2]);
-			normalIndices.push_back(normalIndex[0]);
-			normalIndices.push_back(normalIndex[1]);
-			normalIndices.push_back(normalIndex[2]);
-		}else if(strcmp( lineHeader , "usemtl") == 0){
-			out_materialIndices.push_back(fcount);//last material used face counts	
-			char material[50];
-			fscanf(file, "%s", material);
-			out_mtls.push_back(material);
-			fcount = 0;//face count for next material
-		}else{
-			// Probably a comment, eat up the rest of the line
-			char stupidBuffer[1000];
-			fgets(stupidBuffer, 1000, file);
-		}
+	// every corner of every triangle gets its own vertex, as it always did
+	out_vertices.reserve(out_vertices.size() + mesh.indices.size());
+	out_uvs.reserve(out_uvs.size() + mesh.indices.size());
+	out_normals.reserve(out_normals.size() + mesh.indices.size());
+	for (unsigned int i : mesh.indices) {
+		const float* v = &mesh.vertices[(size_t)i * MESH_VERTEX_FLOATS];
+		out_vertices.push_back(vec3(v[0], v[1], v[2]));
+		out_uvs     .push_back(vec2(v[3], v[4]));
+		out_normals .push_back(vec3(v[5], v[6], v[7]));
 	}
-	out_materialIndices.push_back(fcount);//at the end , push the last faces
-	// For each vertex of each triangle
-	for( unsigned int i=0; i<vertexIndices.size(); i++ ){
-		// Get the indices of its attributes
-		unsigned int vertexIndex = vertexIndices[i];
-		unsigned int uvIndex = uvIndices[i];
-		unsigned int normalIndex = normalIndices[i];
-		
-		// Get the attributes thanks to the index
-		vec3 vertex = temp_vertices[ vertexIndex-1 ];
-		vec2 uv = temp_uvs[ uvIndex-1 ];
-		vec3 normal = temp_normals[ normalIndex-1 ];
-		
-		// Put the attributes in buffers
-		out_vertices.push_back(vertex);
-		out_uvs     .push_back(uv);
-		out_normals .push_back(normal);
+
+	// the face count before the first usemtl, then the name and face count of each
+	size_t r = 0;
+	if (!mesh.ranges.empty() && !mesh.ranges[0].material[0])
+		out_materialIndices.push_back(mesh.ranges[r++].count / 3);
+	else
+		out_materialIndices.push_back(0);
+	for (; r < mesh.ranges.size(); ++r) {
+		out_mtls.push_back(mesh.ranges[r].material);
+		out_materialIndices.push_back(mesh.ranges[r].count / 3);
 	}
 
 	return true;
@@ -27,6 +27,9 @@ uniform sampler2D tiles;
 
 uniform samplerCube skyBox;
 
+// shaders/shadow.frag, linked in (see ShadowMap.H)
+vec3 shadowed(vec3 color, vec3 worldPosition);
+
 vec2 intersectCube(vec3 origin, vec3 ray, vec3 cubeMin, vec3 cubeMax) 
 {
 	vec3 tMin = (cubeMin - origin) / ray;
@@ -97,7 +100,7 @@ void main()
     vec3 refractionColor = getSurfaceRayColor(vec3(refractTexCoords.y, 0.0, refractTexCoords.x), refractionVector, vec3(1.0f)) * vec3(0.0f, 0.8f, 1.0f);
 
     if(f_in.normal.y > 0)
-		f_color = vec4(mix(reflectionColor, refractionColor, ratio_of_reflection_and_refraction), 1.0f);
+		f_color = vec4(shadowed(mix(reflectionColor, refractionColor, ratio_of_reflection_and_refraction), f_in.position), 1.0f);
 	else
-		f_color = vec4(refractionColor, 1.0f);
+		f_color = vec4(shadowed(refractionColor, f_in.position), 1.0f);
 }
\ No newline at end of file
@@ -6,21 +6,28 @@ layout (location = 2) in vec2 texture_coordinate;
 const float PI = 3.14159;
 const float speed = 1.0f;
 
-uniform vec2 dropPoint;
 float interactiveAmplitude = 0.15f;
 float interactiveWavelength = 0.5f;
 float interactiveSpeed = 8.0f;
 
-uniform mat4 u_model;
+// what changes from one draw to the next (UniformBlock in Shader.h)
+layout (std140, binding = 2) uniform per_draw
+{
+    mat4 u_model;
+};
 uniform sampler2D u_texture;
 
 uniform float amplitude;
 float wavelength = 1.0f;
 uniform float time;
 
-uniform float interactiveRadius;
+// heights of the ripple simulation in red, see WaterRipples.H
+uniform sampler2D u_ripples;
 
-uniform float dropTime;
+// cells per side when the grid comes from gl_VertexID (see WaterGrid.H),
+// 0 when it comes from the attributes
+uniform int u_grid_cells;
+uniform float u_grid_height;
 
 layout (std140, binding = 0) uniform commom_matrices
 {
@@ -38,18 +45,30 @@ out V_OUT
 
 void main()
 {
-    vec3 heightMap = position;
+    vec3 gridPosition = position;
+    vec3 gridNormal = normal;
+    vec2 gridCoordinate = texture_coordinate;
+    if (u_grid_cells > 0)
+    {
+        // one strip per row: even vertices on the row, odd ones on the next
+        vec2 cell = vec2(gl_VertexID >> 1, gl_InstanceID + (gl_VertexID & 1));
+        gridCoordinate = cell / float(u_grid_cells);
+        gridPosition = vec3(gridCoordinate.x * 2.0f - 1.0f, u_grid_height, gridCoordinate.y * 2.0f - 1.0f);
+        gridNormal = vec3(0.0f, 1.0f, 0.0f);
+    }
+
+    vec3 heightMap = gridPosition;
 
-    float tempHeight = (texture(u_texture, texture_coordinate).r) * 0.1f;
-    float tempInteractive = 0.0f;
+    float tempHeight = (texture(u_texture, gridCoordinate).r) * 0.1f;
+    float tempInteractive = texture(u_ripples, gridCoordinate).r;
         
-    heightMap.y += tempHeight * amplitude * 5.0f;
+    heightMap.y += tempHeight * amplitude * 5.0f + tempInteractive;
 
-    vec4 worldPosition = u_model * vec4(position, 1.0f);
+    vec4 worldPosition = u_model * vec4(gridPosition, 1.0f);
     v_out.clipSpace = u_projection * u_view * worldPosition;
     gl_Position = u_projection * u_view * u_model * vec4(heightMap, 1.0f);
     
     v_out.position = vec3(u_model * vec4(heightMap, 1.0f));
-    v_out.normal = mat3(transpose(inverse(u_model))) * normal;
+    v_out.normal = mat3(transpose(inverse(u_model))) * gridNormal;
     //v_out.texture_coordinate = vec2(texture_coordinate.x, 1.0f - texture_coordinate.y);
 }
\ No newline at end of file
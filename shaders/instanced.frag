@@ -0,0 +1,29 @@
+#version 430 core
+out vec4 f_color;
+
+in V_OUT
+{
+   vec3 position;
+   vec3 normal;
+   vec3 eye_position;
+} f_in;
+
+uniform vec4 u_color;
+uniform bool u_shadow;		// drawn into the shadow map: only depth is written
+
+// roughly GL_LIGHT0 of the fixed function scene
+const vec3 light_direction = vec3(0.0f, 0.7071f, 0.7071f);
+const float ambient = 0.3f;
+
+// shaders/shadow.frag, linked in (see ShadowMap.H). The instances are
+// placed relative to the modelview, so the point is in eye space
+vec3 shadowedEye(vec3 color, vec3 eyePosition);
+
+void main()
+{
+    if (u_shadow)
+        return;
+
+    float diffuse = max(dot(normalize(f_in.normal), light_direction), 0.0f);
+    f_color = vec4(shadowedEye(u_color.rgb * min(ambient + diffuse, 1.0f), f_in.eye_position), u_color.a);
+}
@@ -0,0 +1,27 @@
+#version 430 core
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 normal;
+layout (location = 3) in mat4 instance_model;	// uses locations 3 to 6
+
+// taken from the fixed function matrices at draw time, so these draws
+// follow the light's matrices in the shadow pass too (see ShadowMap.H)
+uniform mat4 u_view;
+uniform mat4 u_projection;
+
+out V_OUT
+{
+   vec3 position;
+   vec3 normal;
+   vec3 eye_position;
+} v_out;
+
+void main()
+{
+    vec4 world = instance_model * vec4(position, 1.0f);
+    vec4 eye = u_view * world;
+    gl_Position = u_projection * eye;
+
+    v_out.position = world.xyz;
+    v_out.normal = mat3(instance_model) * normal;
+    v_out.eye_position = eye.xyz;
+}
@@ -0,0 +1,28 @@
+#version 430 core
+out vec4 f_color;
+
+in V_OUT
+{
+   vec3 position;
+   vec3 normal;
+   vec4 color;
+} f_in;
+
+uniform bool u_shadow;		// drawn into the shadow map: only depth is written
+
+// roughly GL_LIGHT0 of the fixed function scene
+const vec3 light_direction = vec3(0.0f, 0.7071f, 0.7071f);
+const float ambient = 0.3f;
+
+// shaders/shadow.frag, linked in (see ShadowMap.H). The transforms put
+// the parts in the world, so the point is in world space
+vec3 shadowed(vec3 color, vec3 worldPosition);
+
+void main()
+{
+    if (u_shadow)
+        return;
+
+    float diffuse = max(dot(normalize(f_in.normal), light_direction), 0.0f);
+    f_color = vec4(shadowed(f_in.color.rgb * min(ambient + diffuse, 1.0f), f_in.position), f_in.color.a);
+}
@@ -0,0 +1,39 @@
+#version 430 core
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec2 texture_coordinate;
+layout (location = 2) in vec3 normal;
+layout (location = 3) in uvec2 draw;		// transform, material of this command
+
+// a model matrix per part per character, see ModelArena
+layout (std430, binding = 0) buffer Transforms
+{
+    mat4 transforms[];
+};
+
+layout (std430, binding = 1) buffer Materials
+{
+    vec4 materials[];
+};
+
+// taken from the fixed function matrices at draw time, so these draws
+// follow the light's matrices in the shadow pass too (see ShadowMap.H)
+uniform mat4 u_view;
+uniform mat4 u_projection;
+
+out V_OUT
+{
+   vec3 position;
+   vec3 normal;
+   vec4 color;
+} v_out;
+
+void main()
+{
+    mat4 model = transforms[draw.x];
+    vec4 world = model * vec4(position, 1.0f);
+    gl_Position = u_projection * u_view * world;
+
+    v_out.position = world.xyz;
+    v_out.normal = mat3(model) * normal;
+    v_out.color = materials[draw.y];
+}
@@ -0,0 +1,39 @@
+#version 330 core
+in vec2 uv;
+out vec2 state;
+
+const float PI = 3.14159;
+
+// red the height now, green the height a step before
+uniform sampler2D u_state;
+uniform float u_wave_speed;
+uniform float u_damping;
+
+// drops that fell since the last step: point xy, radius, strength
+uniform vec4 u_drops[32];
+uniform int u_drop_count;
+
+float height(ivec2 p)
+{
+    ivec2 last = textureSize(u_state, 0) - 1;
+    return texelFetch(u_state, clamp(p, ivec2(0), last), 0).r;
+}
+
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    vec2 now = texelFetch(u_state, p, 0).rg;
+
+    float laplacian = height(p + ivec2(1, 0)) + height(p - ivec2(1, 0))
+        + height(p + ivec2(0, 1)) + height(p - ivec2(0, 1)) - 4.0f * now.r;
+    float next = (2.0f * now.r - now.g + u_wave_speed * laplacian) * u_damping;
+
+    for (int i = 0; i < u_drop_count; ++i)
+    {
+        float d = distance(uv, u_drops[i].xy);
+        if (d < u_drops[i].z)
+            next -= u_drops[i].w * 0.5f * (cos(PI * d / u_drops[i].z) + 1.0f);
+    }
+
+    state = vec2(next, now.r);
+}
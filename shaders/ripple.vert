@@ -0,0 +1,10 @@
+#version 330 core
+
+// one triangle over the whole target, see WaterRipples.H
+out vec2 uv;
+
+void main()
+{
+    uv = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(uv * 2.0f - 1.0f, 0.0f, 1.0f);
+}
@@ -0,0 +1,44 @@
+#version 430 core
+
+// Linked into the fragment shaders that receive shadows, which declare
+// the functions they call. See ShadowMap.H
+
+layout (std140, binding = 1) uniform shadow_map
+{
+    mat4 u_shadow_world;    // world -> map, depth in z
+    mat4 u_shadow_eye;      // camera eye space -> map
+    vec4 u_shadow_params;   // texel size, pcf radius, bias, enabled
+};
+
+layout (binding = 7) uniform sampler2DShadow u_shadow_map;
+
+// how much a lit point that is in shadow keeps
+const float shadow_darkness = 0.5f;
+
+float shadowLight(vec4 p)
+{
+    if (u_shadow_params.w == 0.0f)
+        return 1.0f;
+
+    vec3 map = p.xyz / p.w;
+    if (any(lessThan(map, vec3(0.0f))) || any(greaterThan(map, vec3(1.0f))))
+        return 1.0f;
+
+    int radius = int(u_shadow_params.y);
+    float lit = 0.0f;
+    for (int y = -radius; y <= radius; ++y)
+        for (int x = -radius; x <= radius; ++x)
+            lit += texture(u_shadow_map, vec3(map.xy + vec2(x, y) * u_shadow_params.x, map.z - u_shadow_params.z));
+    float taps = float((2 * radius + 1) * (2 * radius + 1));
+    return lit / taps;
+}
+
+vec3 shadowed(vec3 color, vec3 worldPosition)
+{
+    return color * mix(shadow_darkness, 1.0f, shadowLight(u_shadow_world * vec4(worldPosition, 1.0f)));
+}
+
+vec3 shadowedEye(vec3 color, vec3 eyePosition)
+{
+    return color * mix(shadow_darkness, 1.0f, shadowLight(u_shadow_eye * vec4(eyePosition, 1.0f)));
+}
@@ -12,8 +12,11 @@ uniform vec3 u_color;
 
 uniform sampler2D u_texture;
 
+// shaders/shadow.frag, linked in (see ShadowMap.H)
+vec3 shadowed(vec3 color, vec3 worldPosition);
+
 void main()
 {   
     vec3 color = vec3(texture(u_texture, f_in.texture_coordinate));
-    f_color = vec4(color, 1.0f);
+    f_color = vec4(shadowed(color, f_in.position), 1.0f);
 }
\ No newline at end of file
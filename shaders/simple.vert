@@ -3,7 +3,11 @@ layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texture_coordinate;
 
-uniform mat4 u_model;
+// what changes from one draw to the next (UniformBlock in Shader.h)
+layout (std140, binding = 2) uniform per_draw
+{
+    mat4 u_model;
+};
 
 layout (std140, binding = 0) uniform commom_matrices
 {
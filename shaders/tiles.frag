@@ -14,13 +14,16 @@ uniform vec3 u_color;
 
 uniform sampler2D u_texture;
 
+// shaders/shadow.frag, linked in (see ShadowMap.H)
+vec3 shadowed(vec3 color, vec3 worldPosition);
+
 void main()
 {   
     vec3 color = vec3(texture(u_texture, f_in.texture_coordinate));
     //if (vs_normal.z > 0) 
     //    discard;
     //else
-        f_color = vec4(color, 1.0f);
+        f_color = vec4(shadowed(color, f_in.position), 1.0f);
 
         //if (f_in.normal.y < 0)
         //    discard;